@@ -0,0 +1,10 @@
+#!/bin/bash
+
+if [ ! -d ./bin ] ; then
+	mkdir ./bin
+fi
+
+INCLUDES="-I../../src -I../../src/util -I../../src/platform"
+FLAGS="-O2 -DDEBUG -mmacos-version-min=10.15.4"
+
+clang++ $FLAGS -o ./bin/batch_bench $INCLUDES main.cpp
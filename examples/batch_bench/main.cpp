@@ -0,0 +1,136 @@
+/************************************************************//**
+*
+*	@file: main.cpp
+*	@author: Martin Fouilleul
+*	@date: 18/10/2026
+*	@revision:
+*
+*	@brief: compares batched submission of actions and fibers against the per-call path
+*
+*****************************************************************/
+#include<stdio.h>
+#include<stdlib.h>
+#include"sched_main.cpp"
+
+const u32 ROUND_COUNT = 200;
+const u32 MAX_BATCH_SIZE = 512;
+
+void bench_action_callback(void* userPointer)
+{
+	u64* counter = (u64*)userPointer;
+	(*counter)++;
+}
+
+i64 bench_fiber_proc(void* userPointer)
+{
+	return(0);
+}
+
+//NOTE(martin): all submissions are made at the same logical time, and we wait until they have all been executed
+//              before the next round. Only the submission time is measured.
+
+f64 bench_actions_per_call(u32 count)
+{
+	u64 counter = 0;
+	f64 total = 0;
+	for(u32 round=0; round<ROUND_COUNT; round++)
+	{
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<count; i++)
+		{
+			sched_action_no_copy(bench_action_callback, &counter);
+		}
+		total += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+		sched_wait(1);
+	}
+	return(total / ROUND_COUNT);
+}
+
+f64 bench_actions_batch(u32 count)
+{
+	u64 counter = 0;
+	sched_action_desc descs[MAX_BATCH_SIZE];
+	for(u32 i=0; i<count; i++)
+	{
+		descs[i] = (sched_action_desc){.steps = 0, .callback = bench_action_callback, .size = 0, .data = (char*)&counter};
+	}
+
+	f64 total = 0;
+	for(u32 round=0; round<ROUND_COUNT; round++)
+	{
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		sched_action_batch(descs, count);
+		total += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+		sched_wait(1);
+	}
+	return(total / ROUND_COUNT);
+}
+
+f64 bench_fibers_per_call(u32 count, sched_steps* steps)
+{
+	f64 total = 0;
+	for(u32 round=0; round<ROUND_COUNT; round++)
+	{
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<count; i++)
+		{
+			sched_fiber fiber = sched_fiber_create(bench_fiber_proc, 0, steps[i]);
+			sched_handle_release(fiber);
+		}
+		total += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+		sched_wait(2);
+	}
+	return(total / ROUND_COUNT);
+}
+
+f64 bench_fibers_batch(u32 count, sched_steps* steps)
+{
+	sched_fiber_desc descs[MAX_BATCH_SIZE];
+	for(u32 i=0; i<count; i++)
+	{
+		descs[i] = (sched_fiber_desc){.proc = bench_fiber_proc, .userPointer = 0, .steps = steps[i]};
+	}
+
+	f64 total = 0;
+	for(u32 round=0; round<ROUND_COUNT; round++)
+	{
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		sched_fiber_create_batch(descs, count, 0);
+		total += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+		sched_wait(2);
+	}
+	return(total / ROUND_COUNT);
+}
+
+int main()
+{
+	//NOTE(martin): run in offline mode so that waiting between rounds doesn't take real time
+	sched_init_options options = {.clock = SCHED_CLOCK_OFFLINE};
+	sched_init_with_options(&options);
+
+	sched_steps steps[MAX_BATCH_SIZE];
+	srand(1234);
+	for(u32 i=0; i<MAX_BATCH_SIZE; i++)
+	{
+		steps[i] = (rand() % 1000) / 1000.;
+	}
+
+	printf("%-10s %-8s %14s %14s %8s\n", "kind", "count", "per call (us)", "batch (us)", "speedup");
+
+	u32 counts[] = {16, 64, 256, 512};
+	for(u32 i=0; i<sizeof(counts)/sizeof(u32); i++)
+	{
+		f64 perCall = bench_actions_per_call(counts[i]);
+		f64 batch = bench_actions_batch(counts[i]);
+		printf("%-10s %-8u %14.2f %14.2f %8.2f\n", "actions", counts[i], perCall*1e6, batch*1e6, perCall/batch);
+	}
+	for(u32 i=0; i<sizeof(counts)/sizeof(u32); i++)
+	{
+		f64 perCall = bench_fibers_per_call(counts[i], steps);
+		f64 batch = bench_fibers_batch(counts[i], steps);
+		printf("%-10s %-8u %14.2f %14.2f %8.2f\n", "fibers", counts[i], perCall*1e6, batch*1e6, perCall/batch);
+	}
+
+	sched_end();
+	return(0);
+}
@@ -0,0 +1,1032 @@
+/************************************************************//**
+*
+*	@file: main.cpp
+*	@author: Martin Fouilleul
+*	@date: 18/10/2026
+*	@revision:
+*
+*	@brief: measures accuracy and cost of the tempo curves evaluation paths
+*
+*****************************************************************/
+#include<stdio.h>
+#include<stdlib.h>
+#include"sched_main.cpp"
+
+const u32 CURVE_COUNT = 64;
+const u32 CURVE_ELT_COUNT = 16;
+const u32 SAMPLE_COUNT = 4096;
+
+//NOTE(martin): xorshift generator, so that runs are reproducible across platforms
+static u64 benchRandomState = 0x9e3779b97f4a7c15ULL;
+
+//NOTE(martin): set when an accuracy check fails, so that main() returns an error
+static bool benchFailed = false;
+
+void bench_check_error(const char* name, f64 error, f64 bound)
+{
+	if(error > bound)
+	{
+		printf("\tFAILED: %s error %.3e is above %.3e\n", name, error, bound);
+		benchFailed = true;
+	}
+}
+
+f64 bench_random(f64 low, f64 high)
+{
+	benchRandomState ^= benchRandomState << 13;
+	benchRandomState ^= benchRandomState >> 7;
+	benchRandomState ^= benchRandomState << 17;
+	return(low + (high - low) * (f64)(benchRandomState >> 11) / (f64)(1ULL<<53));
+}
+
+void bench_random_bezier_elements(u32 eltCount, sched_curve_descriptor_elt* elements)
+{
+	f64 value = bench_random(0.5, 4);
+	for(u32 i=0; i<eltCount; i++)
+	{
+		f64 endValue = bench_random(0.5, 4);
+		elements[i] = (sched_curve_descriptor_elt){.type = SCHED_CURVE_BEZIER,
+		                                           .length = bench_random(0.5, 8),
+		                                           .startValue = value,
+		                                           .endValue = endValue,
+		                                           .p1x = bench_random(0, 1),
+		                                           .p1y = bench_random(0, 1),
+		                                           .p2x = bench_random(0, 1),
+		                                           .p2y = bench_random(0, 1)};
+		value = endValue;
+	}
+}
+
+f64 bench_curve_total_position(sched_curve* curve)
+{
+	f64 total = 0;
+	for(u32 i=0; i<curve->eltCount; i++)
+	{
+		total += (curve->axes == SCHED_CURVE_POS_TEMPO) ? curve->elements[i].length : curve->elements[i].transformedLength;
+	}
+	return(total);
+}
+
+f64 bench_curve_total_time(sched_curve* curve)
+{
+	f64 total = 0;
+	for(u32 i=0; i<curve->eltCount; i++)
+	{
+		total += (curve->axes == SCHED_CURVE_POS_TEMPO) ? curve->elements[i].transformedLength : curve->elements[i].length;
+	}
+	return(total);
+}
+
+void bench_curve_evaluate(sched_curve* curve, bool fromTime, f64 input, f64* output)
+{
+	if(fromTime)
+	{
+		sched_curve_get_position_from_time(curve, input, output);
+	}
+	else
+	{
+		sched_curve_get_time_from_position(curve, input, output);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Default evaluation path vs RKCK reference
+//------------------------------------------------------------------------------------------------------
+
+void bench_against_reference(sched_curve_axes axes, bool fromTime)
+{
+	printf("%s Bezier curves, %s (%u curves, %u samples each)\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "Position-tempo" : "Time-tempo",
+	       fromTime ? "position from time" : "time from position",
+	       CURVE_COUNT,
+	       SAMPLE_COUNT);
+
+	sched_curve_descriptor_elt elements[CURVE_ELT_COUNT];
+	f64* inputs = (f64*)malloc(sizeof(f64)*SAMPLE_COUNT);
+	f64* reference = (f64*)malloc(sizeof(f64)*SAMPLE_COUNT);
+
+	f64 maxRelError = 0;
+	f64 maxError = 0;
+	f64 tolerance = 0;
+	f64 rkckTime = 0;
+	f64 defaultTime = 0;
+
+	for(u32 curveIndex=0; curveIndex<CURVE_COUNT; curveIndex++)
+	{
+		bench_random_bezier_elements(CURVE_ELT_COUNT, elements);
+
+		sched_curve_descriptor desc = {.axes = axes,
+		                               .eltCount = CURVE_ELT_COUNT,
+		                               .elements = elements,
+		                               .quadrature = SCHED_CURVE_QUADRATURE_RKCK};
+		sched_curve* rkckCurve = sched_curve_create(&desc);
+
+		desc.quadrature = SCHED_CURVE_QUADRATURE_GAUSS;
+		sched_curve* curve = sched_curve_create(&desc);
+		tolerance = curve->tolerance;
+
+		f64 total = fromTime ? bench_curve_total_time(rkckCurve) : bench_curve_total_position(rkckCurve);
+		for(u32 i=0; i<SAMPLE_COUNT; i++)
+		{
+			inputs[i] = bench_random(0, total);
+		}
+
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<SAMPLE_COUNT; i++)
+		{
+			bench_curve_evaluate(rkckCurve, fromTime, inputs[i], &reference[i]);
+		}
+		rkckTime += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<SAMPLE_COUNT; i++)
+		{
+			f64 result = 0;
+			bench_curve_evaluate(curve, fromTime, inputs[i], &result);
+
+			f64 error = fabs(result - reference[i]);
+			maxError = maximum(maxError, error);
+			maxRelError = maximum(maxRelError, error / maximum(fabs(reference[i]), 1e-9));
+		}
+		defaultTime += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		sched_curve_destroy(rkckCurve);
+		sched_curve_destroy(curve);
+	}
+
+	f64 sampleCount = CURVE_COUNT * SAMPLE_COUNT;
+	printf("\trkck:    %8.1f ns/eval\n", rkckTime / sampleCount * 1e9);
+	printf("\tdefault: %8.1f ns/eval, max error %.3e, max relative error %.3e\n",
+	       defaultTime / sampleCount * 1e9,
+	       maxError,
+	       maxRelError);
+	bench_check_error("default path", maxError, tolerance);
+
+	free(inputs);
+	free(reference);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Compiled curves vs exact integration
+//------------------------------------------------------------------------------------------------------
+
+void bench_compiled(sched_curve_axes axes, f64 tolerance)
+{
+	printf("%s Bezier curves compiled with tolerance %.0e (%u curves, %u samples each)\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "Position-tempo" : "Time-tempo",
+	       tolerance,
+	       CURVE_COUNT,
+	       SAMPLE_COUNT);
+
+	sched_curve_descriptor_elt elements[CURVE_ELT_COUNT];
+	f64* inputs = (f64*)malloc(sizeof(f64)*SAMPLE_COUNT);
+	f64* reference = (f64*)malloc(sizeof(f64)*SAMPLE_COUNT);
+
+	sched_curve_compile_report total = {};
+	f64 maxPosError = 0;
+	f64 maxTimeError = 0;
+	f64 exactTime = 0;
+	f64 compiledTime = 0;
+	f64 createTime = 0;
+
+	for(u32 curveIndex=0; curveIndex<CURVE_COUNT; curveIndex++)
+	{
+		bench_random_bezier_elements(CURVE_ELT_COUNT, elements);
+
+		sched_curve_descriptor desc = {.axes = axes, .eltCount = CURVE_ELT_COUNT, .elements = elements};
+		sched_curve* exactCurve = sched_curve_create(&desc);
+
+		desc.compile = true;
+		desc.compileTolerance = tolerance;
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		sched_curve* curve = sched_curve_create(&desc);
+		createTime += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		sched_curve_compile_report report;
+		sched_curve_get_compile_report(curve, &report);
+		total.compiledEltCount += report.compiledEltCount;
+		total.fallbackEltCount += report.fallbackEltCount;
+		total.coeffCount += report.coeffCount;
+		total.maxPosError = maximum(total.maxPosError, report.maxPosError);
+		total.maxTimeError = maximum(total.maxTimeError, report.maxTimeError);
+
+		for(int direction=0; direction<2; direction++)
+		{
+			bool fromTime = (direction == 0);
+			f64 length = fromTime ? bench_curve_total_time(exactCurve) : bench_curve_total_position(exactCurve);
+			for(u32 i=0; i<SAMPLE_COUNT; i++)
+			{
+				inputs[i] = bench_random(0, length);
+			}
+
+			start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+			for(u32 i=0; i<SAMPLE_COUNT; i++)
+			{
+				bench_curve_evaluate(exactCurve, fromTime, inputs[i], &reference[i]);
+			}
+			exactTime += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+			f64 maxError = 0;
+			start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+			for(u32 i=0; i<SAMPLE_COUNT; i++)
+			{
+				f64 result = 0;
+				bench_curve_evaluate(curve, fromTime, inputs[i], &result);
+				maxError = maximum(maxError, fabs(result - reference[i]));
+			}
+			compiledTime += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+			if(fromTime)
+			{
+				maxPosError = maximum(maxPosError, maxError);
+			}
+			else
+			{
+				maxTimeError = maximum(maxTimeError, maxError);
+			}
+		}
+		sched_curve_destroy(exactCurve);
+		sched_curve_destroy(curve);
+	}
+
+	f64 sampleCount = 2 * CURVE_COUNT * SAMPLE_COUNT;
+	printf("\treport:   %u compiled elements, %u fallbacks, %.1f coefficients per element, %.1f us per curve creation\n",
+	       total.compiledEltCount,
+	       total.fallbackEltCount,
+	       (f64)total.coeffCount / (CURVE_COUNT * CURVE_ELT_COUNT),
+	       createTime / CURVE_COUNT * 1e6);
+	printf("\t          error bound at creation: pos %.3e, time %.3e\n", total.maxPosError, total.maxTimeError);
+	printf("\texact:    %8.1f ns/eval\n", exactTime / sampleCount * 1e9);
+	printf("\tcompiled: %8.1f ns/eval, max error pos %.3e, time %.3e\n",
+	       compiledTime / sampleCount * 1e9,
+	       maxPosError,
+	       maxTimeError);
+
+	free(inputs);
+	free(reference);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Cursor vs absolute queries
+//------------------------------------------------------------------------------------------------------
+
+void bench_cursor(sched_curve_axes axes, u32 eltCount, f64 tickDuration)
+{
+	printf("%s Bezier curve of %u elements, position from time in %.0f ms ticks\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "Position-tempo" : "Time-tempo",
+	       eltCount,
+	       tickDuration*1000);
+
+	sched_curve_descriptor_elt* elements = (sched_curve_descriptor_elt*)malloc(sizeof(sched_curve_descriptor_elt)*eltCount);
+	bench_random_bezier_elements(eltCount, elements);
+
+	sched_curve_descriptor desc = {.axes = axes, .eltCount = eltCount, .elements = elements};
+	sched_curve* curve = sched_curve_create(&desc);
+
+	f64 totalTime = bench_curve_total_time(curve);
+	u32 tickCount = (u32)(totalTime/tickDuration);
+	f64* reference = (f64*)malloc(sizeof(f64)*tickCount);
+
+	f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	for(u32 i=0; i<tickCount; i++)
+	{
+		sched_curve_get_position_from_time(curve, i*tickDuration, &reference[i]);
+	}
+	f64 absoluteTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	sched_curve_cursor cursor;
+	sched_curve_cursor_init(&cursor);
+	f64 maxError = 0;
+
+	start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	for(u32 i=0; i<tickCount; i++)
+	{
+		f64 pos = 0;
+		sched_curve_cursor_get_position_from_time(curve, &cursor, i*tickDuration, &pos);
+		maxError = maximum(maxError, fabs(pos - reference[i]));
+	}
+	f64 cursorTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	printf("\tabsolute: %8.1f ns/tick\n", absoluteTime / tickCount * 1e9);
+	printf("\tcursor:   %8.1f ns/tick, max difference %.3e\n", cursorTime / tickCount * 1e9, maxError);
+
+	sched_curve_destroy(curve);
+	free(reference);
+	free(elements);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Element search
+//------------------------------------------------------------------------------------------------------
+
+u32 bench_search_scan(sched_curve* curve, f64 time)
+{
+	//NOTE(martin): linear scan over the elements, as done before the boundaries were stored separately
+	for(u32 i=0; i<curve->eltCount; i++)
+	{
+		if(curve->elements[i].transformedEnd >= time)
+		{
+			return(i);
+		}
+	}
+	return(curve->eltCount);
+}
+
+void bench_search(u32 eltCount)
+{
+	const u32 queryCount = 1<<20;
+
+	sched_curve_descriptor_elt* elements = (sched_curve_descriptor_elt*)malloc(sizeof(sched_curve_descriptor_elt)*eltCount);
+	for(u32 i=0; i<eltCount; i++)
+	{
+		elements[i] = (sched_curve_descriptor_elt){.type = SCHED_CURVE_CONST, .length = bench_random(0.5, 8), .startValue = bench_random(0.5, 4)};
+	}
+	sched_curve_descriptor desc = {.axes = SCHED_CURVE_POS_TEMPO, .eltCount = eltCount, .elements = elements};
+	sched_curve* curve = sched_curve_create(&desc);
+
+	f64* queries = (f64*)malloc(sizeof(f64)*queryCount);
+	f64 totalTime = bench_curve_total_time(curve);
+	for(u32 i=0; i<queryCount; i++)
+	{
+		queries[i] = bench_random(0, totalTime);
+	}
+
+	const char* names[3] = {"scan", "probe", "binary"};
+	f64 times[3] = {};
+	u64 checksums[3] = {};
+	for(int method=0; method<3; method++)
+	{
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<queryCount; i++)
+		{
+			switch(method)
+			{
+				case 0:
+					checksums[method] += bench_search_scan(curve, queries[i]);
+					break;
+				case 1:
+					checksums[method] += sched_curve_search_probe(curve->eltStartTimes + 1, eltCount, queries[i]);
+					break;
+				case 2:
+					checksums[method] += sched_curve_search_binary(curve->eltStartTimes + 1, eltCount, queries[i]);
+					break;
+			}
+		}
+		times[method] = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+	}
+
+	printf("\t%5u elements:", eltCount);
+	for(int method=0; method<3; method++)
+	{
+		printf("  %s %7.1f ns", names[method], times[method] / queryCount * 1e9);
+	}
+	printf("%s\n", (checksums[1] == checksums[0] && checksums[2] == checksums[0]) ? "" : "  (MISMATCH)");
+
+	sched_curve_destroy(curve);
+	free(queries);
+	free(elements);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Batch conversions
+//------------------------------------------------------------------------------------------------------
+
+void bench_batch(sched_curve_axes axes, sched_curve_type type, bool sorted)
+{
+	const u32 eltCount = 64;
+	const u32 count = 1<<16;
+	const char* typeNames[3] = {"const", "linear", "bezier"};
+
+	printf("%s %s curve, %s inputs\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "Position-tempo" : "Time-tempo",
+	       typeNames[type],
+	       sorted ? "sorted" : "random");
+
+	sched_curve_descriptor_elt elements[eltCount];
+	bench_random_bezier_elements(eltCount, elements);
+	for(u32 i=0; i<eltCount; i++)
+	{
+		elements[i].type = type;
+	}
+	sched_curve_descriptor desc = {.axes = axes, .eltCount = eltCount, .elements = elements};
+	sched_curve* curve = sched_curve_create(&desc);
+
+	f64* inputs = (f64*)malloc(sizeof(f64)*count);
+	f64* reference = (f64*)malloc(sizeof(f64)*count);
+	f64* outputs = (f64*)malloc(sizeof(f64)*count);
+
+	for(int direction=0; direction<2; direction++)
+	{
+		bool fromTime = (direction == 0);
+
+		//NOTE(martin): go slightly past the end of the curve to also exercise the extension
+		f64 length = 1.01 * (fromTime ? bench_curve_total_time(curve) : bench_curve_total_position(curve));
+		for(u32 i=0; i<count; i++)
+		{
+			inputs[i] = sorted ? length*i/count : bench_random(0, length);
+		}
+
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<count; i++)
+		{
+			bench_curve_evaluate(curve, fromTime, inputs[i], &reference[i]);
+		}
+		f64 scalarTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		if(fromTime)
+		{
+			sched_curve_get_positions_from_times(curve, inputs, outputs, count);
+		}
+		else
+		{
+			sched_curve_get_times_from_positions(curve, inputs, outputs, count);
+		}
+		f64 batchTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		f64 maxRelError = 0;
+		for(u32 i=0; i<count; i++)
+		{
+			maxRelError = maximum(maxRelError, fabs(outputs[i] - reference[i]) / maximum(fabs(reference[i]), 1e-9));
+		}
+		printf("\t%s: scalar %7.1f ns, batch %7.1f ns, max relative difference %.3e\n",
+		       fromTime ? "pos from time" : "time from pos",
+		       scalarTime / count * 1e9,
+		       batchTime / count * 1e9,
+		       maxRelError);
+	}
+
+	sched_curve_destroy(curve);
+	free(inputs);
+	free(reference);
+	free(outputs);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Incremental edits
+//------------------------------------------------------------------------------------------------------
+
+f64 bench_edit_compare(sched_curve* curve, sched_curve* reference)
+{
+	f64 error = 0;
+	for(u32 i=0; i<=curve->eltCount; i++)
+	{
+		error = maximum(error, fabs(curve->eltStartTimes[i] - reference->eltStartTimes[i]));
+		error = maximum(error, fabs(curve->eltStartPositions[i] - reference->eltStartPositions[i]));
+	}
+	return(error);
+}
+
+void bench_edit(sched_curve_axes axes, u32 eltCount, bool compile)
+{
+	//NOTE(martin): replace one element of a long curve, either at the end (typical of a live tempo track) or in the
+	//              middle, and compare with recreating the whole curve from the edited descriptor.
+	const u32 runCount = 8;
+
+	sched_curve_descriptor_elt* elements = (sched_curve_descriptor_elt*)malloc(sizeof(sched_curve_descriptor_elt)*eltCount);
+	bench_random_bezier_elements(eltCount, elements);
+	sched_curve_descriptor desc = {.axes = axes, .eltCount = eltCount, .elements = elements, .compile = compile};
+	sched_curve* curve = sched_curve_create(&desc);
+
+	printf("Edits, %s axes, %u bezier elements%s\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "pos-tempo" : "time-tempo",
+	       eltCount,
+	       compile ? ", compiled" : "");
+
+	u32 editIndices[2] = {eltCount-1, eltCount/2};
+	const char* names[2] = {"last", "middle"};
+
+	for(int edit=0; edit<2; edit++)
+	{
+		u32 index = editIndices[edit];
+		sched_curve_descriptor_elt newElt = elements[index];
+		newElt.p1y = bench_random(0, 1);
+		newElt.p2y = bench_random(0, 1);
+		newElt.length *= 1.5;
+
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		sched_curve* edited = 0;
+		for(u32 run=0; run<runCount; run++)
+		{
+			if(edited)
+			{
+				sched_curve_release(edited);
+			}
+			edited = sched_curve_replace_range(curve, index, 1, 1, &newElt);
+		}
+		f64 editTime = (ClockGetTime(SYS_CLOCK_MONOTONIC) - start)/runCount;
+
+		sched_curve_descriptor_elt oldElt = elements[index];
+		elements[index] = newElt;
+
+		start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		sched_curve* reference = 0;
+		for(u32 run=0; run<runCount; run++)
+		{
+			if(reference)
+			{
+				sched_curve_release(reference);
+			}
+			reference = sched_curve_create(&desc);
+		}
+		f64 createTime = (ClockGetTime(SYS_CLOCK_MONOTONIC) - start)/runCount;
+		elements[index] = oldElt;
+
+		printf("\t%-6s  edit %9.1f us  create %9.1f us  speedup %7.1fx  max breakpoint diff %.2e\n",
+		       names[edit],
+		       editTime*1e6,
+		       createTime*1e6,
+		       createTime/editTime,
+		       bench_edit_compare(edited, reference));
+
+		sched_curve_release(edited);
+		sched_curve_release(reference);
+	}
+	sched_curve_release(curve);
+	free(elements);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Lazy curves
+//------------------------------------------------------------------------------------------------------
+
+void bench_lazy(sched_curve_axes axes, sched_curve_quadrature quadrature, u32 eltCount)
+{
+	//NOTE(martin): compare the creation of an eager and a lazy curve, the first query near the start of the lazy
+	//              curve, and a prewarm of the whole lazy curve.
+	sched_curve_descriptor_elt* elements = (sched_curve_descriptor_elt*)malloc(sizeof(sched_curve_descriptor_elt)*eltCount);
+	bench_random_bezier_elements(eltCount, elements);
+	sched_curve_descriptor desc = {.axes = axes, .eltCount = eltCount, .elements = elements, .quadrature = quadrature};
+
+	f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve* eager = sched_curve_create(&desc);
+	f64 eagerTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	desc.lazy = true;
+	start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve* lazy = sched_curve_create(&desc);
+	f64 lazyTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	f64 endTime = bench_curve_total_time(eager);
+	f64 queryTime = endTime / eltCount;
+	f64 lazyPos = 0;
+	f64 eagerPos = 0;
+	start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve_get_position_from_time(lazy, queryTime, &lazyPos);
+	f64 firstQueryTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+	sched_curve_get_position_from_time(eager, queryTime, &eagerPos);
+
+	start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve_prewarm(lazy, endTime);
+	f64 prewarmTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	printf("Lazy curve, %s axes, %s quadrature, %u bezier elements\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "pos-tempo" : "time-tempo",
+	       (quadrature == SCHED_CURVE_QUADRATURE_GAUSS) ? "gauss" : "rkck",
+	       eltCount);
+	printf("\tcreate: eager %9.3f ms  lazy %9.3f ms\n", eagerTime*1e3, lazyTime*1e3);
+	printf("\tfirst query %9.3f us (difference %.2e), full prewarm %9.3f ms\n",
+	       firstQueryTime*1e6,
+	       fabs(lazyPos - eagerPos),
+	       prewarmTime*1e3);
+
+	sched_curve_release(eager);
+	sched_curve_release(lazy);
+	free(elements);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Sampled tempo tracks
+//------------------------------------------------------------------------------------------------------
+
+u64 bench_curve_memory(sched_curve* curve)
+{
+	u64 size = sched_curve_block_size(curve->eltCount) + curve->chebyshevCoeffCount*sizeof(f64);
+	for(u32 i=0; i<curve->eltCount; i++)
+	{
+		sched_curve_samples* samples = curve->elements[i].samples;
+		if(samples)
+		{
+			size += sizeof(sched_curve_samples) + samples->count*(sizeof(f64) + sizeof(f32));
+			size += samples->offsets ? samples->count*sizeof(f64) : 0;
+		}
+	}
+	return(size);
+}
+
+void bench_sampled(sched_curve_axes axes, bool uniform)
+{
+	//NOTE(martin): a 10 minutes performance captured every 10 ms, as one sampled element or as linear elements
+	const u32 sampleCount = 60000;
+	const u32 queryCount = 1<<20;
+
+	f32* samples = (f32*)malloc(sampleCount*sizeof(f32));
+	f64* offsets = (f64*)malloc(sampleCount*sizeof(f64));
+	sched_curve_descriptor_elt* linear = (sched_curve_descriptor_elt*)malloc((sampleCount-1)*sizeof(sched_curve_descriptor_elt));
+
+	f64 value = 2;
+	for(u32 i=0; i<sampleCount; i++)
+	{
+		value = maximum(0.5, value + bench_random(-0.02, 0.02));
+		samples[i] = value;
+		offsets[i] = uniform ? i*0.01 : (i ? offsets[i-1] + bench_random(0.005, 0.015) : 0);
+	}
+	for(u32 i=0; i<sampleCount-1; i++)
+	{
+		linear[i] = (sched_curve_descriptor_elt){.type = SCHED_CURVE_LINEAR,
+		                                         .length = offsets[i+1] - offsets[i],
+		                                         .startValue = samples[i],
+		                                         .endValue = samples[i+1]};
+	}
+	sched_curve_descriptor_elt sampled = {.type = SCHED_CURVE_SAMPLED,
+	                                      .length = offsets[sampleCount-1],
+	                                      .sampleCount = sampleCount,
+	                                      .samples = samples,
+	                                      .sampleOffsets = uniform ? 0 : offsets};
+
+	sched_curve_descriptor linearDesc = {.axes = axes, .eltCount = sampleCount-1, .elements = linear};
+	sched_curve_descriptor sampledDesc = {.axes = axes, .eltCount = 1, .elements = &sampled};
+
+	f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve* linearCurve = sched_curve_create(&linearDesc);
+	f64 linearCreateTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+	sched_curve* sampledCurve = sched_curve_create(&sampledDesc);
+	f64 sampledCreateTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+	printf("Sampled tempo track, %s axes, %u %s samples\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "pos-tempo" : "time-tempo",
+	       sampleCount,
+	       uniform ? "uniform" : "non-uniform");
+	printf("\tmemory: linear elements %8.1f KB  sampled %8.1f KB\n",
+	       bench_curve_memory(linearCurve)/1024.,
+	       bench_curve_memory(sampledCurve)/1024.);
+	printf("\tcreate: linear elements %8.3f ms  sampled %8.3f ms\n", linearCreateTime*1e3, sampledCreateTime*1e3);
+
+	f64* inputs = (f64*)malloc(queryCount*sizeof(f64));
+	for(int fromTime=1; fromTime>=0; fromTime--)
+	{
+		f64 total = fromTime ? bench_curve_total_time(linearCurve) : bench_curve_total_position(linearCurve);
+		for(u32 i=0; i<queryCount; i++)
+		{
+			inputs[i] = bench_random(0, total);
+		}
+		sched_curve* curves[2] = {linearCurve, sampledCurve};
+		f64 times[2] = {};
+		f64 checksums[2] = {};
+		for(int c=0; c<2; c++)
+		{
+			start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+			for(u32 i=0; i<queryCount; i++)
+			{
+				f64 output = 0;
+				bench_curve_evaluate(curves[c], fromTime, inputs[i], &output);
+				checksums[c] += output;
+			}
+			times[c] = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+		}
+		printf("\t%s: linear elements %7.1f ns  sampled %7.1f ns  mean relative difference %.2e\n",
+		       fromTime ? "pos from time" : "time from pos",
+		       times[0]/queryCount*1e9,
+		       times[1]/queryCount*1e9,
+		       fabs(checksums[1] - checksums[0])/fabs(checksums[0]));
+	}
+
+	sched_curve_release(linearCurve);
+	sched_curve_release(sampledCurve);
+	free(inputs);
+	free(linear);
+	free(offsets);
+	free(samples);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Closed-form element types
+//------------------------------------------------------------------------------------------------------
+
+void bench_element_types(sched_curve_axes axes)
+{
+	//NOTE(martin): cost of the conversions and round trip error for each element type, on curves of random ramps
+	const u32 queryCount = 1<<18;
+
+	const char* names[] = {"linear", "exponential", "power", "step", "bezier gauss", "bezier rkck"};
+	sched_curve_type types[] = {SCHED_CURVE_LINEAR, SCHED_CURVE_EXPONENTIAL, SCHED_CURVE_POWER, SCHED_CURVE_STEP, SCHED_CURVE_BEZIER, SCHED_CURVE_BEZIER};
+	sched_curve_quadrature quadratures[] = {SCHED_CURVE_QUADRATURE_GAUSS,
+	                                        SCHED_CURVE_QUADRATURE_GAUSS,
+	                                        SCHED_CURVE_QUADRATURE_GAUSS,
+	                                        SCHED_CURVE_QUADRATURE_GAUSS,
+	                                        SCHED_CURVE_QUADRATURE_GAUSS,
+	                                        SCHED_CURVE_QUADRATURE_RKCK};
+
+	printf("Element types, %s axes\n", (axes == SCHED_CURVE_POS_TEMPO) ? "pos-tempo" : "time-tempo");
+
+	sched_curve_descriptor_elt elements[CURVE_ELT_COUNT];
+	f64* inputs = (f64*)malloc(queryCount*sizeof(f64));
+
+	for(u32 typeIndex=0; typeIndex<sizeof(types)/sizeof(sched_curve_type); typeIndex++)
+	{
+		bench_random_bezier_elements(CURVE_ELT_COUNT, elements);
+		for(u32 i=0; i<CURVE_ELT_COUNT; i++)
+		{
+			elements[i].type = types[typeIndex];
+			elements[i].exponent = bench_random(0.5, 3);
+		}
+		sched_curve_descriptor desc = {.axes = axes,
+		                               .eltCount = CURVE_ELT_COUNT,
+		                               .elements = elements,
+		                               .quadrature = quadratures[typeIndex]};
+		sched_curve* curve = sched_curve_create(&desc);
+
+		f64 totalTime = bench_curve_total_time(curve);
+		for(u32 i=0; i<queryCount; i++)
+		{
+			inputs[i] = bench_random(0, totalTime);
+		}
+
+		f64 positionSum = 0;
+		f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+		for(u32 i=0; i<queryCount; i++)
+		{
+			f64 pos = 0;
+			sched_curve_get_position_from_time(curve, inputs[i], &pos);
+			positionSum += pos;
+		}
+		f64 posFromTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+		f64 maxError = 0;
+		f64 timeFromPos = 0;
+		for(u32 i=0; i<queryCount; i++)
+		{
+			f64 pos = 0;
+			f64 time = 0;
+			sched_curve_get_position_from_time(curve, inputs[i], &pos);
+
+			start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+			sched_curve_get_time_from_position(curve, pos, &time);
+			timeFromPos += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+			maxError = maximum(maxError, fabs(time - inputs[i]));
+		}
+
+		printf("\t%-12s pos from time %8.1f ns  time from pos %8.1f ns  round trip error %.2e\n",
+		       names[typeIndex],
+		       posFromTime/queryCount*1e9,
+		       timeFromPos/queryCount*1e9,
+		       maxError);
+
+		sched_curve_release(curve);
+	}
+	free(inputs);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Accuracy vs cost
+//------------------------------------------------------------------------------------------------------
+
+typedef struct bench_tolerance_config
+{
+	const char* name;
+	sched_curve_quadrature quadrature;
+	sched_curve_profile profile;
+	f64 tolerance;
+	bool compile;
+
+} bench_tolerance_config;
+
+void bench_tolerance(sched_curve_axes axes)
+{
+	//NOTE(martin): errors are measured against a Gauss-Legendre curve with a 1e-12 tolerance. We use fewer curves
+	//              than the other benchmarks, since the Runge-Kutta rows are slow.
+	const u32 curveCount = 8;
+	const u32 sampleCount = 1024;
+
+	bench_tolerance_config configs[] = {
+		{"gauss precise",    SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_PRECISE, 0, false},
+		{"gauss 1e-6",       SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_PRECISE, 1e-6, false},
+		{"gauss fast",       SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_FAST, 0, false},
+		{"gauss 1e-3",       SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_PRECISE, 1e-3, false},
+		{"rkck precise",     SCHED_CURVE_QUADRATURE_RKCK, SCHED_CURVE_PROFILE_PRECISE, 0, false},
+		{"rkck 1e-6",        SCHED_CURVE_QUADRATURE_RKCK, SCHED_CURVE_PROFILE_PRECISE, 1e-6, false},
+		{"rkck fast",        SCHED_CURVE_QUADRATURE_RKCK, SCHED_CURVE_PROFILE_FAST, 0, false},
+		{"compiled precise", SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_PRECISE, 0, true},
+		{"compiled fast",    SCHED_CURVE_QUADRATURE_GAUSS, SCHED_CURVE_PROFILE_FAST, 0, true}};
+
+	const u32 configCount = sizeof(configs)/sizeof(bench_tolerance_config);
+
+	printf("%s Bezier curves, accuracy vs cost (%u curves, %u samples each)\n",
+	       (axes == SCHED_CURVE_POS_TEMPO) ? "Position-tempo" : "Time-tempo",
+	       curveCount,
+	       sampleCount);
+
+	f64 createTimes[configCount] = {};
+	f64 evalTimes[configCount][2] = {};
+	f64 maxErrors[configCount][2] = {};
+
+	sched_curve_descriptor_elt elements[CURVE_ELT_COUNT];
+	f64* inputs[2];
+	f64* reference[2];
+	for(int direction=0; direction<2; direction++)
+	{
+		inputs[direction] = (f64*)malloc(sizeof(f64)*sampleCount);
+		reference[direction] = (f64*)malloc(sizeof(f64)*sampleCount);
+	}
+
+	for(u32 curveIndex=0; curveIndex<curveCount; curveIndex++)
+	{
+		bench_random_bezier_elements(CURVE_ELT_COUNT, elements);
+
+		sched_curve_descriptor desc = {.axes = axes, .eltCount = CURVE_ELT_COUNT, .elements = elements, .tolerance = 1e-12};
+		sched_curve* referenceCurve = sched_curve_create(&desc);
+
+		for(int direction=0; direction<2; direction++)
+		{
+			bool fromTime = (direction == 0);
+			f64 length = fromTime ? bench_curve_total_time(referenceCurve) : bench_curve_total_position(referenceCurve);
+			for(u32 i=0; i<sampleCount; i++)
+			{
+				inputs[direction][i] = bench_random(0, length);
+				bench_curve_evaluate(referenceCurve, fromTime, inputs[direction][i], &reference[direction][i]);
+			}
+		}
+		sched_curve_destroy(referenceCurve);
+
+		for(u32 configIndex=0; configIndex<configCount; configIndex++)
+		{
+			bench_tolerance_config* config = &configs[configIndex];
+			desc.quadrature = config->quadrature;
+			desc.profile = config->profile;
+			desc.tolerance = config->tolerance;
+			desc.compile = config->compile;
+
+			f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+			sched_curve* curve = sched_curve_create(&desc);
+			createTimes[configIndex] += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+			for(int direction=0; direction<2; direction++)
+			{
+				bool fromTime = (direction == 0);
+				f64 maxError = 0;
+				start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+				for(u32 i=0; i<sampleCount; i++)
+				{
+					f64 result = 0;
+					bench_curve_evaluate(curve, fromTime, inputs[direction][i], &result);
+					maxError = maximum(maxError, fabs(result - reference[direction][i]));
+				}
+				evalTimes[configIndex][direction] += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+				maxErrors[configIndex][direction] = maximum(maxErrors[configIndex][direction], maxError);
+			}
+			sched_curve_destroy(curve);
+		}
+	}
+
+	printf("\t%-16s %12s %14s %12s %14s %12s\n", "", "create (us)", "pos (ns/eval)", "pos error", "time (ns/eval)", "time error");
+	for(u32 configIndex=0; configIndex<configCount; configIndex++)
+	{
+		printf("\t%-16s %12.1f %14.1f %12.3e %14.1f %12.3e\n",
+		       configs[configIndex].name,
+		       createTimes[configIndex] / curveCount * 1e6,
+		       evalTimes[configIndex][0] / (curveCount * sampleCount) * 1e9,
+		       maxErrors[configIndex][0],
+		       evalTimes[configIndex][1] / (curveCount * sampleCount) * 1e9,
+		       maxErrors[configIndex][1]);
+	}
+
+	for(int direction=0; direction<2; direction++)
+	{
+		free(inputs[direction]);
+		free(reference[direction]);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Bezier x solver
+//------------------------------------------------------------------------------------------------------
+
+void bench_solve_x()
+{
+	//NOTE(martin): control points x coordinates, including the degenerate cases of flat end tangents (0 or 1),
+	//              coincident control points, and linear (1/3, 2/3) or quadratic x(s)
+	const f64 controls[] = {0, 1e-9, 1e-4, 0.1, 1./3, 0.5, 2./3, 0.9, 1-1e-4, 1-1e-9, 1};
+	const u32 controlCount = sizeof(controls)/sizeof(f64);
+	const f64 lengths[] = {1e-3, 1, 1e3};
+	const u32 lengthCount = sizeof(lengths)/sizeof(f64);
+	const u32 solveCount = 4096;
+
+	f64 maxError[2] = {};
+	f64 maxToleranceRatio = 0; // closed form error relative to xTolerance
+	f64 times[2] = {};
+	u32 kindCounts[4] = {};
+	u32 setCount = 0;
+
+	f64* inputs = (f64*)malloc(sizeof(f64)*solveCount);
+	f64* outputs = (f64*)malloc(sizeof(f64)*solveCount);
+
+	for(u32 l=0; l<lengthCount; l++)
+	{
+		for(u32 i=0; i<controlCount; i++)
+		{
+			for(u32 j=0; j<controlCount; j++)
+			{
+				f64 length = lengths[l];
+				bezier_coeffs coeffs;
+				bezier_coeffs_init_with_control_points(&coeffs, 0, 1, controls[i]*length, 1, controls[j]*length, 1, length, 1);
+				kindCounts[coeffs.xSolveKind]++;
+				setCount++;
+
+				for(u32 k=0; k<solveCount; k++)
+				{
+					inputs[k] = length*k/(solveCount-1);
+				}
+				for(int method=0; method<2; method++)
+				{
+					f64 start = ClockGetTime(SYS_CLOCK_MONOTONIC);
+					for(u32 k=0; k<solveCount; k++)
+					{
+						outputs[k] = (method == 0) ? bezier_solve_x_iterative(&coeffs, inputs[k]) : bezier_solve_x(&coeffs, inputs[k]);
+					}
+					times[method] += ClockGetTime(SYS_CLOCK_MONOTONIC) - start;
+
+					for(u32 k=0; k<solveCount; k++)
+					{
+						f64 error = fabs(bezier_sample_x(&coeffs, outputs[k]) - inputs[k]);
+						maxError[method] = maximum(maxError[method], error/length);
+						if(method == 1)
+						{
+							maxToleranceRatio = maximum(maxToleranceRatio, error/coeffs.xTolerance);
+						}
+					}
+				}
+			}
+		}
+	}
+	printf("Bezier x solver, %u control points sets (%u linear, %u quadratic, %u cubic, %u non-monotonic)\n",
+	       setCount,
+	       kindCounts[BEZIER_SOLVE_LINEAR],
+	       kindCounts[BEZIER_SOLVE_QUADRATIC],
+	       kindCounts[BEZIER_SOLVE_CUBIC],
+	       kindCounts[BEZIER_SOLVE_ITERATIVE]);
+
+	f64 sampleCount = setCount * solveCount;
+	printf("\titerative:   %6.1f ns/solve, max relative error in x %.3e\n", times[0] / sampleCount * 1e9, maxError[0]);
+	printf("\tclosed form: %6.1f ns/solve, max relative error in x %.3e\n", times[1] / sampleCount * 1e9, maxError[1]);
+	bench_check_error("closed form solve (relative to xTolerance)", maxToleranceRatio, 1);
+
+	free(inputs);
+	free(outputs);
+}
+
+int main()
+{
+	ClockSystemInit();
+
+	bench_solve_x();
+
+	bench_against_reference(SCHED_CURVE_POS_TEMPO, false);
+	bench_against_reference(SCHED_CURVE_POS_TEMPO, true);
+	bench_against_reference(SCHED_CURVE_TIME_TEMPO, false);
+	bench_against_reference(SCHED_CURVE_TIME_TEMPO, true);
+
+	bench_compiled(SCHED_CURVE_POS_TEMPO, 1e-9);
+	bench_compiled(SCHED_CURVE_TIME_TEMPO, 1e-9);
+	bench_compiled(SCHED_CURVE_POS_TEMPO, 1e-6);
+
+	bench_cursor(SCHED_CURVE_POS_TEMPO, 16, 0.001);
+	bench_cursor(SCHED_CURVE_POS_TEMPO, 1024, 0.01);
+	bench_cursor(SCHED_CURVE_TIME_TEMPO, 1024, 0.01);
+
+	printf("Element search, random queries\n");
+	bench_search(8);
+	bench_search(32);
+	bench_search(256);
+	bench_search(5000);
+
+	for(int axes=0; axes<2; axes++)
+	{
+		for(int type=0; type<3; type++)
+		{
+			bench_batch((sched_curve_axes)axes, (sched_curve_type)type, true);
+		}
+		bench_batch((sched_curve_axes)axes, SCHED_CURVE_BEZIER, false);
+	}
+
+	bench_edit(SCHED_CURVE_POS_TEMPO, 5000, false);
+	bench_edit(SCHED_CURVE_TIME_TEMPO, 5000, false);
+	bench_edit(SCHED_CURVE_POS_TEMPO, 1000, true);
+
+	bench_lazy(SCHED_CURVE_POS_TEMPO, SCHED_CURVE_QUADRATURE_GAUSS, 50000);
+	bench_lazy(SCHED_CURVE_POS_TEMPO, SCHED_CURVE_QUADRATURE_RKCK, 50000);
+	bench_lazy(SCHED_CURVE_TIME_TEMPO, SCHED_CURVE_QUADRATURE_GAUSS, 50000);
+
+	bench_sampled(SCHED_CURVE_POS_TEMPO, true);
+	bench_sampled(SCHED_CURVE_TIME_TEMPO, true);
+	bench_sampled(SCHED_CURVE_TIME_TEMPO, false);
+
+	bench_element_types(SCHED_CURVE_POS_TEMPO);
+	bench_element_types(SCHED_CURVE_TIME_TEMPO);
+
+	bench_tolerance(SCHED_CURVE_POS_TEMPO);
+	bench_tolerance(SCHED_CURVE_TIME_TEMPO);
+	return(benchFailed ? 1 : 0);
+}
@@ -6,7 +6,16 @@
 *	@revision:
 *
 *****************************************************************/
+#include<float.h>
 #include<math.h>
+#include<stdlib.h>
+#include<string.h>
+#if defined(__SSE2__)
+	#include<emmintrin.h>
+#endif
+#if defined(__x86_64__)
+	#include<immintrin.h>
+#endif
 #include"macro_helpers.h"
 #include"sched_curves_internal.h"
 
@@ -392,10 +401,133 @@ int rkck_integrate(double* y_out,
 	return(-1);
 }
 
+//------------------------------------------------------------------------------------------------------
+// Composite Gauss-Legendre quadrature
+//------------------------------------------------------------------------------------------------------
+
+//NOTE(martin): 8 points Gauss-Legendre rule on [-1, 1]. Nodes are symmetric, so we only store the positive half.
+const f64 GAUSS_LEGENDRE_8_NODES[4] = {0.1834346424956498049394761,
+                                      0.5255324099163289858177390,
+                                      0.7966664774136267395915539,
+                                      0.9602898564975362316835609};
+
+const f64 GAUSS_LEGENDRE_8_WEIGHTS[4] = {0.3626837833783619829651504,
+                                        0.3137066458778872873379622,
+                                        0.2223810344533744705443560,
+                                        0.1012285362903762591525314};
+
+const u32 GAUSS_LEGENDRE_MAX_PANELS = 256;
+
+double gauss_legendre_panel(double a, double b, deriv_function_ptr f, void* context)
+{
+	double halfWidth = 0.5*(b - a);
+	double center = 0.5*(a + b);
+	double result = 0;
+	for(int i=0; i<4; i++)
+	{
+		double offset = halfWidth * GAUSS_LEGENDRE_8_NODES[i];
+		result += GAUSS_LEGENDRE_8_WEIGHTS[i] * (f(center - offset, context) + f(center + offset, context));
+	}
+	return(result * halfWidth);
+}
+
+double gauss_legendre_integrate(double a, double b, u32 panelCount, deriv_function_ptr f, void* context)
+{
+	double width = (b - a)/panelCount;
+	double result = 0;
+	for(u32 i=0; i<panelCount; i++)
+	{
+		result += gauss_legendre_panel(a + i*width, a + (i+1)*width, f, context);
+	}
+	return(result);
+}
+
+u32 gauss_legendre_select_panel_count(double a, double b, deriv_function_ptr f, void* context, double tolerance)
+{
+	//NOTE(martin): double the number of panels until the result changes by less than the (absolute) tolerance. The
+	//              difference between n and 2n panels is a (pessimistic) estimate of the error with n panels. We don't
+	//              ask for less than the rounding error of the sum.
+	u32 panelCount = 1;
+	double result = gauss_legendre_integrate(a, b, panelCount, f, context);
+
+	while(panelCount < GAUSS_LEGENDRE_MAX_PANELS)
+	{
+		double refined = gauss_legendre_integrate(a, b, 2*panelCount, f, context);
+		if(fabs(refined - result) <= maximum(tolerance, 16*DBL_EPSILON*fabs(refined)))
+		{
+			break;
+		}
+		panelCount *= 2;
+		result = refined;
+	}
+	if(panelCount >= GAUSS_LEGENDRE_MAX_PANELS)
+	{
+		LOG_WARNING("quadrature didn't reach tolerance with %u panels\n", panelCount);
+	}
+	return(panelCount);
+}
+
 //------------------------------------------------------------------------------------------------------
 // Bezier curve functions
 //------------------------------------------------------------------------------------------------------
 
+const f64 M_SQRT3 = 1.7320508075688772935274463;
+
+const u32 BEZIER_SOLVE_ITERATIVE = 0,
+          BEZIER_SOLVE_LINEAR = 1,
+          BEZIER_SOLVE_QUADRATIC = 2,
+          BEZIER_SOLVE_CUBIC = 3;
+
+void bezier_coeffs_init_x_solve(bezier_coeffs* coeffs)
+{
+	f64 c1 = coeffs->cx[1];
+	f64 c2 = coeffs->cx[2];
+	f64 c3 = coeffs->cx[3];
+	f64 scale = fabs(c1) + fabs(c2) + fabs(c3);
+
+	//NOTE(martin): x(s) is monotonic on [0, 1] if the minimum of x'(s) = c1 + 2*c2*s + 3*c3*s^2 over [0, 1] isn't
+	//              negative. This is the case when p1x and p2x are inside the element, and then x(s) = x has
+	//              exactly one root in [0, 1]. Otherwise we keep the iterative solver.
+	f64 minSlope = minimum(c1, c1 + 2*c2 + 3*c3);
+	if(c3 > 0)
+	{
+		f64 vertex = -c2/(3*c3);
+		if(vertex > 0 && vertex < 1)
+		{
+			minSlope = minimum(minSlope, c1 + vertex*(2*c2 + 3*c3*vertex));
+		}
+	}
+	if(scale == 0 || minSlope < -1e-12*scale)
+	{
+		LOG_WARNING("bezier x coordinates are not monotonic, falling back to iterative solver\n");
+		coeffs->xSolveKind = BEZIER_SOLVE_ITERATIVE;
+		return;
+	}
+
+	//NOTE(martin): coefficients that are negligible are dropped, the solution is then polished by a Newton step
+	//              in bezier_solve_x().
+	const f64 degeneracyThreshold = 1e-7;
+	if(fabs(c3) > degeneracyThreshold*scale)
+	{
+		f64 invA = 1./c3;
+		f64 B = c2*invA;
+		f64 C = c1*invA;
+		coeffs->xSolveKind = BEZIER_SOLVE_CUBIC;
+		coeffs->xSolve[0] = invA;
+		coeffs->xSolve[1] = B/3;
+		coeffs->xSolve[2] = C - B*B/3;
+		coeffs->xSolve[3] = 2*B*B*B/27 - B*C/3 + coeffs->cx[0]*invA;
+	}
+	else if(fabs(c2) > degeneracyThreshold*scale)
+	{
+		coeffs->xSolveKind = BEZIER_SOLVE_QUADRATIC;
+	}
+	else
+	{
+		coeffs->xSolveKind = BEZIER_SOLVE_LINEAR;
+	}
+}
+
 void bezier_coeffs_init_with_control_points(bezier_coeffs* coeffs, f64 p0x, f64 p0y, f64 p1x, f64 p1y, f64 p2x, f64 p2y, f64 p3x, f64 p3y)
 {
 	/*NOTE(martin): convert the control points to the power basis, multiplying by M3
@@ -419,6 +551,25 @@ void bezier_coeffs_init_with_control_points(bezier_coeffs* coeffs, f64 p0x, f64
 	coeffs->cy[1] = -3*p0y + 3*p1y;
 	coeffs->cy[2] = 3*p0y - 6*p1y + 3*p2y;
 	coeffs->cy[3] = -p0y + 3*p1y - 3*p2y + p3y;
+
+	//NOTE(martin): multiply y(s) by x'(s) = cx1 + 2*cx2*s + 3*cx3*s^2, and integrate term by term
+	f64 dx[3] = {coeffs->cx[1], 2*coeffs->cx[2], 3*coeffs->cx[3]};
+	f64 product[6] = {};
+	for(int i=0; i<4; i++)
+	{
+		for(int j=0; j<3; j++)
+		{
+			product[i+j] += coeffs->cy[i]*dx[j];
+		}
+	}
+	coeffs->yDxIntegral[0] = 0;
+	for(int k=0; k<6; k++)
+	{
+		coeffs->yDxIntegral[k+1] = product[k]/(k+1);
+	}
+
+	bezier_coeffs_init_x_solve(coeffs);
+	coeffs->xTolerance = 1e-12;
 }
 
 double bezier_sample_x(bezier_coeffs* coeffs, double s)
@@ -441,13 +592,17 @@ double bezier_dyds(bezier_coeffs* coeffs, double s)
 	return((3*coeffs->cy[3]*s + 2*coeffs->cy[2])*s + coeffs->cy[1]);
 }
 
-double bezier_solve_x(bezier_coeffs* coeffs, double x)
+double bezier_d2xds2(bezier_coeffs* coeffs, double s)
+{
+	return(6*coeffs->cx[3]*s + 2*coeffs->cx[2]);
+}
+
+double bezier_solve_x_iterative(bezier_coeffs* coeffs, double x)
 {
 	// find s parameter for a given value of x
 
 	//TODO: assert good value of x
-	//      pass epsilon
-	const double epsilon = 1e-12;
+	const double epsilon = coeffs->xTolerance;
 
 	//NOTE(martin): do 12 Newton-Raphson iteration first
 	double s = 0.5;
@@ -509,14 +664,108 @@ double bezier_solve_x(bezier_coeffs* coeffs, double x)
 	return(s);
 }
 
+double bezier_select_root(double r0, double r1, double r2)
+{
+	//NOTE(martin): select the root that is closest to [0, 1]
+	double d0 = maximum(-r0, r0 - 1);
+	double d1 = maximum(-r1, r1 - 1);
+	double d2 = maximum(-r2, r2 - 1);
+	double r = (d1 < d0) ? r1 : r0;
+	double d = minimum(d0, d1);
+	return((d2 < d) ? r2 : r);
+}
+
+const u32 BEZIER_SOLVE_X_MAX_NEWTON_STEPS = 3;
+
+double bezier_solve_x(bezier_coeffs* coeffs, double x)
+{
+	//NOTE(martin): find the parameter s in [0, 1] such that x(s) = x, with a closed-form solve refined by Newton steps
+	//              until the residual is within xTolerance. One step is usually enough, but the rounding of the
+	//              closed form is relative to the element's length, so long elements may need more.
+	double s = 0;
+	switch(coeffs->xSolveKind)
+	{
+		case BEZIER_SOLVE_LINEAR:
+			s = (x - coeffs->cx[0])/coeffs->cx[1];
+			break;
+
+		case BEZIER_SOLVE_QUADRATIC:
+		{
+			//NOTE(martin): numerically stable form of the quadratic roots
+			double a = coeffs->cx[2];
+			double b = coeffs->cx[1];
+			double c = coeffs->cx[0] - x;
+			double root = sqrt(maximum(b*b - 4*a*c, 0.));
+			double q = -0.5*(b + copysign(root, b));
+			double r0 = q/a;
+			double r1 = (q != 0) ? c/q : r0;
+			s = bezier_select_root(r0, r1, r0);
+		} break;
+
+		case BEZIER_SOLVE_CUBIC:
+		{
+			double shift = coeffs->xSolve[1];
+			double p = coeffs->xSolve[2];
+			double q = coeffs->xSolve[3] - x*coeffs->xSolve[0];
+			double halfQ = 0.5*q;
+			double thirdP = p/3;
+			double disc = halfQ*halfQ + thirdP*thirdP*thirdP;
+
+			//NOTE(martin): a double root (eg. where x'(s) vanishes at an end of the element) gives a null discriminant,
+			//              which rounding can make slightly positive. We only use Cardano's formula when the
+			//              discriminant is clearly positive, since it would miss the double root.
+			if(disc > 1e-12*fabs(thirdP*thirdP*thirdP))
+			{
+				//NOTE(martin): one real root, Cardano's formula
+				double root = sqrt(disc);
+				s = cbrt(-halfQ + root) + cbrt(-halfQ - root) - shift;
+			}
+			else if(thirdP < 0)
+			{
+				//NOTE(martin): three real roots, trigonometric form
+				//              (the other roots use cos(theta -/+ 2pi/3) = -cos(theta)/2 +/- sqrt(3)/2*sin(theta))
+				double m = 2*sqrt(-thirdP);
+				double theta = acos(Clamp(3*q/(p*m), -1., 1.))/3;
+				double cosTheta = cos(theta);
+				double sinTheta = sqrt(maximum(1 - cosTheta*cosTheta, 0.));
+				double r0 = m*cosTheta - shift;
+				double r1 = m*(-0.5*cosTheta + 0.5*M_SQRT3*sinTheta) - shift;
+				double r2 = m*(-0.5*cosTheta - 0.5*M_SQRT3*sinTheta) - shift;
+				s = bezier_select_root(r0, r1, r2);
+			}
+			else
+			{
+				//NOTE(martin): triple root
+				s = cbrt(-q) - shift;
+			}
+		} break;
+
+		default:
+			return(bezier_solve_x_iterative(coeffs, x));
+	}
+
+	s = Clamp(s, 0., 1.);
+	for(u32 i=0; i<BEZIER_SOLVE_X_MAX_NEWTON_STEPS; i++)
+	{
+		double delta = bezier_sample_x(coeffs, s) - x;
+		double dx = bezier_dxds(coeffs, s);
+		if(fabs(delta) <= coeffs->xTolerance || dx <= 1e-12)
+		{
+			break;
+		}
+		s = Clamp(s - delta/dx, 0., 1.);
+	}
+	return(s);
+}
+
 //------------------------------------------------------------------------------------------------------
 // Bezier tempo curve integrations
 //------------------------------------------------------------------------------------------------------
 
-double bezier_tempo_get_position_callback(double s, void* context)
+double bezier_sample_y_dx_integral(bezier_coeffs* coeffs, double s)
 {
-	bezier_coeffs* coeffs = (bezier_coeffs*)context;
-	return(bezier_sample_y(coeffs, s)*bezier_dxds(coeffs, s));
+	const f64* c = coeffs->yDxIntegral;
+	return((((((c[6]*s + c[5])*s + c[4])*s + c[3])*s + c[2])*s + c[1])*s);
 }
 
 double bezier_tempo_get_position(bezier_coeffs* coeffs, double t)
@@ -526,23 +775,20 @@ double bezier_tempo_get_position(bezier_coeffs* coeffs, double t)
 
 	//NOTE(martin): to find the position, we integrate the tempo curve from 0 to t. We make a variable
 	//              change to integrate over s rather than t, which allows to compute parameter s only
-	//              for the bound t.
+	//              for the bound t. The integrand y(s)*x'(s) is a polynomial, so we use its precomputed
+	//              primitive.
 
 	double s = bezier_solve_x(coeffs, t);
-
-	double maxErr = 1e-9;
-	double step_guess = 0.1;
-	double result = 0;
-	int itCount = 0;
-	double estErr = 0;
-	double min_step_size = 1e-9;
-	u32 max_step_count = 10000;
-
-	rkck_integrate(&result, 0, 0, s, step_guess, min_step_size, max_step_count, maxErr, bezier_tempo_get_position_callback, (void*)coeffs, &itCount, &estErr);
-
-	return(result);
+	return(bezier_sample_y_dx_integral(coeffs, s));
 }
 
+//NOTE(martin): the Runge-Kutta integrators control the error of each step relative to the magnitude of y and of the
+//              step's increment, and the errors of all steps add up. So we derive the per-step error from the element's
+//              absolute tolerance with a safety factor. The minimum step size only keeps the step control from stalling,
+//              and doesn't depend on the tolerance.
+const double RKCK_TOLERANCE_SAFETY = 1e-3;
+const double RKCK_MIN_STEP_SIZE = 1e-12;
+
 double bezier_tempo_get_time_callback(double t, void* context)
 {
 	bezier_coeffs* coeffs = (bezier_coeffs*)context;
@@ -550,7 +796,7 @@ double bezier_tempo_get_time_callback(double t, void* context)
 	return(1./bezier_sample_y(coeffs, s));
 }
 
-double bezier_tempo_get_time(bezier_coeffs* coeffs, double p)
+double bezier_tempo_get_time(bezier_coeffs* coeffs, double tolerance, double p)
 {
 	//NOTE(martin): given a non-autonomous tempo curve (representing the tempo with respect to time),
 	//              find the time corresponding to a given position.
@@ -562,7 +808,7 @@ double bezier_tempo_get_time(bezier_coeffs* coeffs, double p)
 	//
 	//              hence, to find t for a given p we must solve the autonomous ODE T'(p) = 1/C(T(p)), (ie y' = 1/C(y))
 
-	double maxErr = 1e-9;
+	double maxErr = tolerance*RKCK_TOLERANCE_SAFETY;
 	double step_guess = 0.1;
 	double result = 0;
 	int itCount = 0;
@@ -570,7 +816,7 @@ double bezier_tempo_get_time(bezier_coeffs* coeffs, double p)
 	double y_start = 0;
 	double t_start = 0;
 	double t_end = p;
-	double min_step_size = 1e-9;
+	double min_step_size = RKCK_MIN_STEP_SIZE;
 	u32 max_step_count = 10000;
 
 	rkck_autonomous(&result, y_start, t_start, t_end, step_guess, min_step_size, max_step_count, maxErr, bezier_tempo_get_time_callback, (void*)coeffs, &itCount, &estErr);
@@ -583,7 +829,7 @@ double bezier_autonomous_tempo_get_time_callback(double s, void* context)
 	return(bezier_dxds(coeffs, s)/bezier_sample_y(coeffs, s));
 }
 
-double bezier_autonomous_tempo_get_time(bezier_coeffs* coeffs, double p)
+double bezier_autonomous_tempo_get_time(bezier_coeffs* coeffs, sched_curve_quadrature quadrature, u32 panelCount, double tolerance, double p)
 {
 	//NOTE(martin): given an autonomous tempo curve (representing the tempo with respect to the timescale position),
 	//              find the time corresponding to a given position.
@@ -595,12 +841,20 @@ double bezier_autonomous_tempo_get_time(bezier_coeffs* coeffs, double p)
 
 	double s = bezier_solve_x(coeffs, p);
 
-	double maxErr = 1e-9;
+	if(quadrature == SCHED_CURVE_QUADRATURE_GAUSS)
+	{
+		//NOTE(martin): the integrand is smooth, so a composite Gauss-Legendre rule reaches the tolerance in a
+		//              few dozen evaluations. panelCount was selected for [0, 1], so we keep panels at most as wide.
+		u32 count = maximum((u32)ceil(s*panelCount), 1u);
+		return(gauss_legendre_integrate(0, s, count, bezier_autonomous_tempo_get_time_callback, (void*)coeffs));
+	}
+
+	double maxErr = tolerance*RKCK_TOLERANCE_SAFETY;
 	double step_guess = 0.1;
 	double result = 0;
 	int itCount = 0;
 	double estErr = 0;
-	double min_step_size = 1e-9;
+	double min_step_size = RKCK_MIN_STEP_SIZE;
 	u32 max_step_count = 10000;
 
 	rkck_integrate(&result, 0, 0, s, step_guess, min_step_size, max_step_count, maxErr, bezier_autonomous_tempo_get_time_callback, (void*)coeffs, &itCount, &estErr);
@@ -614,7 +868,7 @@ double bezier_autonomous_tempo_get_position_callback(double p, void* context)
 	return(bezier_sample_y(coeffs, s));
 }
 
-double bezier_autonomous_tempo_get_position(bezier_coeffs* coeffs, double time)
+double bezier_autonomous_tempo_get_position(bezier_coeffs* coeffs, double tolerance, double time)
 {
 	//NOTE(martin): given an autonomous tempo curve (representing the tempo with respect to the timescale position),
 	//              find the position corresponding to a given time.
@@ -624,7 +878,7 @@ double bezier_autonomous_tempo_get_position(bezier_coeffs* coeffs, double time)
 	//
 	//              hence, to find p for a given t we must solve the autonomous ODE P'(t) = C(P(t)), (ie y' = C(y))
 
-	double maxErr = 1e-9;
+	double maxErr = tolerance*RKCK_TOLERANCE_SAFETY;
 	double step_guess = 0.1;
 	double result = 0;
 	int itCount = 0;
@@ -632,7 +886,7 @@ double bezier_autonomous_tempo_get_position(bezier_coeffs* coeffs, double time)
 	double y_start = 0;
 	double t_start = 0;
 	double t_end = time;
-	double min_step_size = 1e-9;
+	double min_step_size = RKCK_MIN_STEP_SIZE;
 	u32 max_step_count = 10000;
 
 	rkck_autonomous(&result, y_start, t_start, t_end, step_guess, min_step_size, max_step_count, maxErr, bezier_autonomous_tempo_get_position_callback, (void*)coeffs, &itCount, &estErr);
@@ -640,367 +894,1555 @@ double bezier_autonomous_tempo_get_position(bezier_coeffs* coeffs, double time)
 }
 
 //------------------------------------------------------------------------------------------------------
-// tempo curves integration
+// Bezier forward integrals inversion
 //------------------------------------------------------------------------------------------------------
 
-f64 sched_pos_tempo_integrate_over_time(sched_curve_elt* elt, f64 t)
-{
-	//NOTE(martin): do the integration for the remaining of time update in that element
-	//for now we consider that the curve is a linear patch and gives the scaling for a given position
-	f64 posUpdate = 0;
-	f64 C0 = elt->startValue;
+/*NOTE(martin): both axes share the same representation of a bezier element: a forward integral F(s) over the curve
+	parameter s, whose derivative is known in closed form.
 
-	switch(elt->type)
-	{
-		case SCHED_CURVE_CONST:
-		{
-			posUpdate = t*C0;
-		} break;
+	- for time-tempo curves, F(s) is the position at parameter s, with F'(s) = y(s)*x'(s). F is the polynomial
+	  yDxIntegral, and x(s) gives the time.
+	- for position-tempo curves, F(s) is the time at parameter s, with F'(s) = x'(s)/y(s). F is integrated with
+	  Gauss-Legendre quadrature, and x(s) gives the position.
 
-		case SCHED_CURVE_LINEAR:
-		{
-			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
+	The inverse queries (time from position for time-tempo curves, and position from time for position-tempo curves)
+	solve F(s) = target, and then return x(s). This replaces an ODE integration whose right-hand side called
+	bezier_solve_x() at each evaluation.
+*/
 
-			if(abs(alpha) > 1e-9)
-			{
-				posUpdate = C0/alpha*(exp(alpha*t) - 1);
-			}
-			else
-			{
-				//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
-				//              (and possibly raise a divivison-by-zero exception).
-				//              Instead, we take the fourth-order series expansion.
-				f64 t2 = t*t;
-				f64 t3 = t2*t;
-				f64 t4 = t2*t2;
-				f64 t5 = t4*t;
-				f64 alpha2 = alpha*alpha;
-				f64 alpha3 = alpha2*alpha;
-				f64 alpha4 = alpha2*alpha2;
-
-				posUpdate = C0*(t + alpha*t2/2 + alpha2*t3/6 + alpha3*t4/24 + alpha4*t5/120);
-			}
-		} break;
+typedef struct bezier_integral
+{
+	bezier_coeffs* coeffs;
+	sched_curve_axes axes;
+	u32 panelCount;
+	double epsilon; // maximum residual of F(s) = target, relative to max(F(1), 1)
+} bezier_integral;
 
-		case SCHED_CURVE_BEZIER:
-		{
-			posUpdate = bezier_autonomous_tempo_get_position(&elt->coeffs, t);
-		} break;
+double bezier_integral_value(bezier_integral* integral, double s)
+{
+	if(integral->axes == SCHED_CURVE_TIME_TEMPO)
+	{
+		return(bezier_sample_y_dx_integral(integral->coeffs, s));
+	}
+	else
+	{
+		u32 count = maximum((u32)ceil(s*integral->panelCount), 1u);
+		return(gauss_legendre_integrate(0, s, count, bezier_autonomous_tempo_get_time_callback, (void*)integral->coeffs));
 	}
-	return(posUpdate);
 }
 
-f64 sched_pos_tempo_integrate_over_pos(sched_curve_elt* elt, f64 p)
+double bezier_integral_increment(bezier_integral* integral, double value, double s0, double s1)
 {
-	//NOTE(martin): do the integration for the remaining of pos update in that element
-	//for now we consider that the curve is a linear patch and gives the scaling for a given position
-	f64 timeUpdate = 0;
-	f64 C0 = elt->startValue;
-
-	switch(elt->type)
+	//NOTE(martin): return F(s1) given F(s0) = value. For position-tempo curves we only integrate over [s0, s1],
+	//              which gets cheaper as the iteration converges.
+	if(integral->axes == SCHED_CURVE_TIME_TEMPO)
 	{
-		case SCHED_CURVE_CONST:
-		{
-			timeUpdate = p/C0;
-		} break;
-
-		case SCHED_CURVE_LINEAR:
-		{
-			f64 alpha = (elt->endValue - elt->startValue)/elt->length;
-
-			if(abs(alpha) > 1e-9)
-			{
-				timeUpdate = log((C0 + alpha*p)/C0)/alpha;
-			}
-			else
-			{
-				//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
-				//              (and possibly raise a division-by-zero exception).
-				//              Instead, we take the fourth-order series expansion.
-				f64 p2 = p*p;
-				f64 p3 = p2*p;
-				f64 p4 = p2*p2;
-				f64 p5 = p4*p;
-				f64 C02 = C0*C0;
-				f64 C03 = C02*C0;
-				f64 C04 = C02*C02;
-				f64 C05 = C04*C0;
-				f64 alpha2 = alpha*alpha;
-				f64 alpha3 = alpha2*alpha;
-				f64 alpha4 = alpha2*alpha2;
-
-				timeUpdate = p/C0 - alpha*p2/(2*C02) + alpha2*p3/(3*C03) - alpha3*p4/(4*C04) + alpha4*p5/(5*C05);
-			}
-		} break;
-
-		case SCHED_CURVE_BEZIER:
-		{
-			timeUpdate = bezier_autonomous_tempo_get_time(&elt->coeffs, p);
-		} break;
+		return(bezier_sample_y_dx_integral(integral->coeffs, s1));
+	}
+	else
+	{
+		u32 count = maximum((u32)ceil(fabs(s1 - s0)*integral->panelCount), 1u);
+		return(value + gauss_legendre_integrate(s0, s1, count, bezier_autonomous_tempo_get_time_callback, (void*)integral->coeffs));
 	}
-	return(timeUpdate);
 }
 
-f64 sched_time_tempo_integrate_over_time(sched_curve_elt* elt, f64 t)
+void bezier_integral_derivatives(bezier_integral* integral, double s, double* d1, double* d2)
 {
-	//NOTE(martin): do the integration for the remaining of time update in that element
-	//for now we consider that the curve is a linear patch and gives the scaling for a given position
-	f64 posUpdate = 0;
-	f64 C0 = elt->startValue;
+	bezier_coeffs* coeffs = integral->coeffs;
+	double y = bezier_sample_y(coeffs, s);
+	double dy = bezier_dyds(coeffs, s);
+	double dx = bezier_dxds(coeffs, s);
+	double ddx = bezier_d2xds2(coeffs, s);
 
-	switch(elt->type)
+	if(integral->axes == SCHED_CURVE_TIME_TEMPO)
 	{
-		case SCHED_CURVE_CONST:
-		{
-			posUpdate = t*C0;
-		} break;
-
-		case SCHED_CURVE_LINEAR:
-		{
-			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
-			posUpdate = C0*t + 0.5*alpha*t*t;
-		} break;
-
-		case SCHED_CURVE_BEZIER:
-		{
-			posUpdate = bezier_tempo_get_position(&elt->coeffs, t);
-		} break;
+		*d1 = y*dx;
+		*d2 = dy*dx + y*ddx;
+	}
+	else
+	{
+		*d1 = dx/y;
+		*d2 = (ddx*y - dx*dy)/(y*y);
 	}
-	return(posUpdate);
 }
 
-f64 sched_time_tempo_integrate_over_pos(sched_curve_elt* elt, f64 p)
+double bezier_integral_invert_from(bezier_integral* integral,
+                                   double total,
+                                   double target,
+                                   double start,
+                                   double startValue,
+                                   double* outValue)
 {
-	//NOTE(martin): do the integration for the remaining of pos update in that element
-	//for now we consider that the curve is a linear patch and gives the scaling for a given position
-	f64 timeUpdate = 0;
-	f64 C0 = elt->startValue;
+	//NOTE(martin): find s such that F(s) = target, where total = F(1), knowing that F(start) = startValue <= target.
+	//              F is strictly increasing, so we keep a bracket [lo, hi] around the root and take Halley steps,
+	//              falling back to bisection when a step leaves the bracket (eg. when x'(s) vanishes at the ends
+	//              of the element). The value of F at the returned s is stored in outValue.
+	const double epsilon = integral->epsilon;
+	const int maxIterations = 64;
+
+	if(target <= 0)
+	{
+		*outValue = 0;
+		return(0);
+	}
+	if(target >= total)
+	{
+		*outValue = total;
+		return(1);
+	}
+	if(target < startValue)
+	{
+		start = 0;
+		startValue = 0;
+	}
 
-	switch(elt->type)
+	double lo = start;
+	double hi = 1;
+
+	//NOTE(martin): first guess from the derivative at start, which is accurate for small advances,
+	//              or from linear interpolation to the end of the element.
+	double s = lo + (hi - lo)*(target - startValue)/(total - startValue);
+	double d1 = 0;
+	double d2 = 0;
+	bezier_integral_derivatives(integral, start, &d1, &d2);
+	if(d1 > 1e-12)
 	{
-		case SCHED_CURVE_CONST:
+		double guess = start + (target - startValue)/d1;
+		if(guess < hi)
 		{
-			timeUpdate = p/C0;
-		} break;
+			s = guess;
+		}
+	}
+	double value = bezier_integral_increment(integral, startValue, start, s);
 
-		case SCHED_CURVE_LINEAR:
+	for(int i=0; i<maxIterations; i++)
+	{
+		double delta = value - target;
+		if(fabs(delta) <= epsilon*maximum(total, 1.))
+		{
+			break;
+		}
+		if(delta > 0)
+		{
+			hi = s;
+		}
+		else
 		{
-			f64 alpha = (elt->endValue - elt->startValue)/elt->length;
+			lo = s;
+		}
 
-			if(abs(alpha) > 1e-9)
-			{
-				timeUpdate = (sqrt(C0*C0 + 2*alpha*p) - C0)/alpha;
-			}
-			else
+		bezier_integral_derivatives(integral, s, &d1, &d2);
+
+		double next = 0.5*(lo + hi);
+		if(d1 > 1e-12)
+		{
+			double denom = d1 - 0.5*delta*d2/d1;
+			double step = (fabs(denom) > 0.5*d1) ? delta/denom : delta/d1;
+			double candidate = s - step;
+			if(candidate > lo && candidate < hi)
 			{
-				//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
-				//              (and possibly raise a division-by-zero exception).
-				//              Instead, we take the fourth-order series expansion.
-				f64 p2 = p*p;
-				f64 p3 = p2*p;
-				f64 p4 = p2*p2;
-				f64 p5 = p4*p;
-
-				f64 C02 = C0*C0;
-				f64 C03 = C0*C02;
-				f64 C05 = C03*C02;
-				f64 C07 = C05*C02;
-				f64 C09 = C07*C02;
-
-				f64 alpha2 = alpha*alpha;
-				f64 alpha3 = alpha2*alpha;
-				f64 alpha4 = alpha2*alpha2;
-
-				timeUpdate = p/C0 - alpha*p2/(2*C03) + alpha2*p3/(2*C05) - alpha3*p4*5/(8*C07) + alpha4*p5*7/(8*C09);
+				next = candidate;
 			}
-		} break;
-
-		case SCHED_CURVE_BEZIER:
+		}
+		if(next == s)
 		{
-			timeUpdate = bezier_tempo_get_time(&elt->coeffs, p);
-		} break;
+			break;
+		}
+		value = bezier_integral_increment(integral, value, s, next);
+		s = next;
 	}
-	return(timeUpdate);
+	*outValue = value;
+	return(s);
 }
 
+double bezier_integral_invert(bezier_integral* integral, double total, double target)
+{
+	double value = 0;
+	return(bezier_integral_invert_from(integral, total, target, 0, 0, &value));
+}
 
 //------------------------------------------------------------------------------------------------------
-// curves create/destroy
+// linear tempo integrals
 //------------------------------------------------------------------------------------------------------
 
-int sched_curve_replace(sched_curve* curve, sched_curve_descriptor* descriptor)
+f64 linear_pos_tempo_get_position(f64 C0, f64 alpha, f64 t)
 {
-	//NOTE(martin): recompute the whole curve from descriptor
-	curve->axes = descriptor->axes;
-	curve->eltCount = descriptor->eltCount;
-
-	//NOTE(martin): initialize elements with descriptor elements, and precompute breakpoints values
-	f64 start = 0;
-	f64 transformedStart = 0;
-
-	for(int i=0; i<descriptor->eltCount; i++)
+	//NOTE(martin): position after t seconds, for a tempo C0 + alpha*p
+	if(abs(alpha) > 1e-9)
 	{
-		sched_curve_descriptor_elt* descElt = &(descriptor->elements[i]);
-		sched_curve_elt* elt = &(curve->elements[i]);
-
-		elt->type = descElt->type;
-		elt->startValue = descElt->startValue;
-		elt->endValue = descElt->endValue;
-		elt->length = descElt->length;
+		return(C0/alpha*(exp(alpha*t) - 1));
+	}
+	else
+	{
+		//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
+		//              (and possibly raise a divivison-by-zero exception).
+		//              Instead, we take the fourth-order series expansion.
+		f64 t2 = t*t;
+		f64 t3 = t2*t;
+		f64 t4 = t2*t2;
+		f64 t5 = t4*t;
+		f64 alpha2 = alpha*alpha;
+		f64 alpha3 = alpha2*alpha;
+		f64 alpha4 = alpha2*alpha2;
+
+		return(C0*(t + alpha*t2/2 + alpha2*t3/6 + alpha3*t4/24 + alpha4*t5/120));
+	}
+}
 
-		if(elt->length == 0 && elt->type != SCHED_CURVE_CONST)
-		{
-			LOG_ERROR("non-const zero length element in curve descriptor\n");
-			return(-1);
+f64 linear_pos_tempo_get_time(f64 C0, f64 alpha, f64 p)
+{
+	//NOTE(martin): time to reach position p, for a tempo C0 + alpha*p
+	if(abs(alpha) > 1e-9)
+	{
+		return(log((C0 + alpha*p)/C0)/alpha);
+	}
+	else
+	{
+		//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
+		//              (and possibly raise a division-by-zero exception).
+		//              Instead, we take the fourth-order series expansion.
+		f64 p2 = p*p;
+		f64 p3 = p2*p;
+		f64 p4 = p2*p2;
+		f64 p5 = p4*p;
+		f64 C02 = C0*C0;
+		f64 C03 = C02*C0;
+		f64 C04 = C02*C02;
+		f64 C05 = C04*C0;
+		f64 alpha2 = alpha*alpha;
+		f64 alpha3 = alpha2*alpha;
+		f64 alpha4 = alpha2*alpha2;
+
+		return(p/C0 - alpha*p2/(2*C02) + alpha2*p3/(3*C03) - alpha3*p4/(4*C04) + alpha4*p5/(5*C05));
+	}
+}
+
+f64 linear_time_tempo_get_position(f64 C0, f64 alpha, f64 t)
+{
+	//NOTE(martin): position after t seconds, for a tempo C0 + alpha*t
+	return(C0*t + 0.5*alpha*t*t);
+}
+
+f64 linear_time_tempo_get_time(f64 C0, f64 alpha, f64 p)
+{
+	//NOTE(martin): time to reach position p, for a tempo C0 + alpha*t
+	if(abs(alpha) > 1e-9)
+	{
+		return((sqrt(C0*C0 + 2*alpha*p) - C0)/alpha);
+	}
+	else
+	{
+		//NOTE(martin): if alpha is approaching zero, the above formula would diverge and provide inaccurate results.
+		//              (and possibly raise a division-by-zero exception).
+		//              Instead, we take the fourth-order series expansion.
+		f64 p2 = p*p;
+		f64 p3 = p2*p;
+		f64 p4 = p2*p2;
+		f64 p5 = p4*p;
+
+		f64 C02 = C0*C0;
+		f64 C03 = C0*C02;
+		f64 C05 = C03*C02;
+		f64 C07 = C05*C02;
+		f64 C09 = C07*C02;
+
+		f64 alpha2 = alpha*alpha;
+		f64 alpha3 = alpha2*alpha;
+		f64 alpha4 = alpha2*alpha2;
+
+		return(p/C0 - alpha*p2/(2*C03) + alpha2*p3/(2*C05) - alpha3*p4*5/(8*C07) + alpha4*p5*7/(8*C09));
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// exponential and power tempo integrals
+//------------------------------------------------------------------------------------------------------
+
+f64 exp_ratio(f64 a, f64 x)
+{
+	//NOTE(martin): (exp(a*x) - 1)/a
+	if(fabs(a) > 1e-9)
+	{
+		return(expm1(a*x)/a);
+	}
+	else
+	{
+		//NOTE(martin): as for linear elements, we take the fourth-order series expansion when a approaches zero
+		f64 x2 = x*x;
+		f64 x3 = x2*x;
+		f64 x4 = x2*x2;
+		f64 x5 = x4*x;
+		f64 a2 = a*a;
+		f64 a3 = a2*a;
+		f64 a4 = a2*a2;
+
+		return(x + a*x2/2 + a2*x3/6 + a3*x4/24 + a4*x5/120);
+	}
+}
+
+f64 log_ratio(f64 a, f64 y)
+{
+	//NOTE(martin): log(1 + a*y)/a, ie. the inverse of exp_ratio()
+	if(fabs(a) > 1e-9)
+	{
+		return(log1p(a*y)/a);
+	}
+	else
+	{
+		f64 y2 = y*y;
+		f64 y3 = y2*y;
+		f64 y4 = y2*y2;
+		f64 y5 = y4*y;
+		f64 a2 = a*a;
+		f64 a3 = a2*a;
+		f64 a4 = a2*a2;
+
+		return(y - a*y2/2 + a2*y3/3 - a3*y4/4 + a4*y5/5);
+	}
+}
+
+f64 power_ratio(f64 e, f64 beta, f64 x)
+{
+	//NOTE(martin): ((1 + beta*x)^e - 1)/(e*beta), ie. the integral of (1 + beta*u)^(e-1) from 0 to x. It tends to
+	//              log(1 + beta*x)/beta when e approaches zero, which exp_ratio() takes care of.
+	if(fabs(beta) > 1e-9)
+	{
+		return(exp_ratio(e, log1p(beta*x))/beta);
+	}
+	else
+	{
+		//NOTE(martin): third-order series expansion in beta
+		f64 x2 = x*x;
+		f64 x3 = x2*x;
+		f64 x4 = x2*x2;
+		f64 beta2 = beta*beta;
+		f64 beta3 = beta2*beta;
+
+		return(x + (e-1)*beta*x2/2 + (e-1)*(e-2)*beta2*x3/6 + (e-1)*(e-2)*(e-3)*beta3*x4/24);
+	}
+}
+
+f64 power_ratio_inverse(f64 e, f64 beta, f64 z)
+{
+	//NOTE(martin): solves power_ratio(e, beta, x) = z for x, ie. x = ((1 + e*beta*z)^(1/e) - 1)/beta
+	if(fabs(beta) > 1e-9)
+	{
+		return(expm1(log_ratio(e, beta*z))/beta);
+	}
+	else
+	{
+		f64 z2 = z*z;
+		f64 z3 = z2*z;
+		f64 z4 = z2*z2;
+		f64 beta2 = beta*beta;
+		f64 beta3 = beta2*beta;
+
+		return(z + (1-e)*beta*z2/2 + (1-e)*(1-2*e)*beta2*z3/6 + (1-e)*(1-2*e)*(1-3*e)*beta3*z4/24);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// sampled tempo tracks
+//------------------------------------------------------------------------------------------------------
+
+u32 sched_curve_search_binary(const f64* ends, u32 count, f64 x);
+
+f64 sched_curve_samples_segment_forward(sched_curve_axes axes, f64 C0, f64 alpha, f64 x)
+{
+	return((axes == SCHED_CURVE_POS_TEMPO) ? linear_pos_tempo_get_time(C0, alpha, x) : linear_time_tempo_get_position(C0, alpha, x));
+}
+
+f64 sched_curve_samples_segment_inverse(sched_curve_axes axes, f64 C0, f64 alpha, f64 y)
+{
+	return((axes == SCHED_CURVE_POS_TEMPO) ? linear_pos_tempo_get_position(C0, alpha, y) : linear_time_tempo_get_time(C0, alpha, y));
+}
+
+f64 sched_curve_samples_offset(sched_curve_samples* samples, u32 index)
+{
+	return(samples->offsets ? samples->offsets[index] : index*samples->step);
+}
+
+sched_curve_samples* sched_curve_samples_create(sched_curve_axes axes, sched_curve_descriptor_elt* descElt)
+{
+	//NOTE(martin): copy the samples and precompute the integral at each sample. Returns 0 if the samples are invalid.
+	u32 count = descElt->sampleCount;
+	if(count < 2 || !descElt->samples)
+	{
+		LOG_ERROR("sampled curve element needs at least two samples\n");
+		return(0);
+	}
+	for(u32 i=0; i<count; i++)
+	{
+		if(!(descElt->samples[i] > 0))
+		{
+			LOG_ERROR("negative or null tempo sample in curve descriptor\n");
+			return(0);
+		}
+	}
+	if(descElt->sampleOffsets)
+	{
+		if(descElt->sampleOffsets[0] != 0)
+		{
+			LOG_ERROR("sample offsets must start at 0\n");
+			return(0);
+		}
+		for(u32 i=1; i<count; i++)
+		{
+			if(!(descElt->sampleOffsets[i] > descElt->sampleOffsets[i-1]))
+			{
+				LOG_ERROR("sample offsets must be strictly increasing\n");
+				return(0);
+			}
+		}
+	}
+	else if(!(descElt->length > 0))
+	{
+		LOG_ERROR("uniformly sampled curve element needs a positive length\n");
+		return(0);
+	}
+
+	//NOTE(martin): allocate the tables in a single block: header, integral, offsets, then samples.
+	u32 offsetCount = descElt->sampleOffsets ? count : 0;
+	u64 size = sizeof(sched_curve_samples) + (count + offsetCount)*sizeof(f64) + count*sizeof(f32);
+	sched_curve_samples* samples = (sched_curve_samples*)malloc(size);
+
+	samples->refCount = 1;
+	samples->count = count;
+	samples->integral = (f64*)(samples + 1);
+	samples->offsets = offsetCount ? samples->integral + count : 0;
+	samples->values = (f32*)(samples->integral + count + offsetCount);
+
+	memcpy(samples->values, descElt->samples, count*sizeof(f32));
+	if(samples->offsets)
+	{
+		memcpy(samples->offsets, descElt->sampleOffsets, count*sizeof(f64));
+		samples->step = 0;
+		samples->invStep = 0;
+	}
+	else
+	{
+		samples->step = descElt->length/(count-1);
+		samples->invStep = (count-1)/descElt->length;
+	}
+
+	samples->integral[0] = 0;
+	for(u32 i=0; i<count-1; i++)
+	{
+		f64 width = sched_curve_samples_offset(samples, i+1) - sched_curve_samples_offset(samples, i);
+		f64 C0 = samples->values[i];
+		f64 alpha = (samples->values[i+1] - C0)/width;
+		samples->integral[i+1] = samples->integral[i] + sched_curve_samples_segment_forward(axes, C0, alpha, width);
+	}
+	return(samples);
+}
+
+sched_curve_samples* sched_curve_samples_retain(sched_curve_samples* samples)
+{
+	samples->refCount++;
+	return(samples);
+}
+
+void sched_curve_samples_release(sched_curve_samples* samples)
+{
+	DEBUG_ASSERT(samples->refCount);
+	if(--samples->refCount == 0)
+	{
+		free(samples);
+	}
+}
+
+f64 sched_curve_samples_forward(sched_curve_samples* samples, sched_curve_axes axes, f64 x)
+{
+	//NOTE(martin): integrate from the start of the element to x on the main axis. The segment is found in O(1) for
+	//              uniform samples, and with a binary search otherwise.
+	u32 index = 0;
+	if(samples->offsets)
+	{
+		index = sched_curve_search_binary(samples->offsets + 1, samples->count-1, x);
+	}
+	else if(x > 0)
+	{
+		index = (u32)minimum(x*samples->invStep, (f64)(samples->count-1));
+	}
+	index = minimum(index, samples->count-2);
+
+	f64 start = sched_curve_samples_offset(samples, index);
+	f64 width = sched_curve_samples_offset(samples, index+1) - start;
+	f64 C0 = samples->values[index];
+	f64 alpha = (samples->values[index+1] - C0)/width;
+
+	return(samples->integral[index] + sched_curve_samples_segment_forward(axes, C0, alpha, x - start));
+}
+
+f64 sched_curve_samples_inverse(sched_curve_samples* samples, sched_curve_axes axes, f64 y)
+{
+	//NOTE(martin): find the location on the main axis where the integral reaches y
+	u32 index = sched_curve_search_binary(samples->integral + 1, samples->count-1, y);
+	index = minimum(index, samples->count-2);
+
+	f64 start = sched_curve_samples_offset(samples, index);
+	f64 width = sched_curve_samples_offset(samples, index+1) - start;
+	f64 C0 = samples->values[index];
+	f64 alpha = (samples->values[index+1] - C0)/width;
+
+	return(start + sched_curve_samples_segment_inverse(axes, C0, alpha, y - samples->integral[index]));
+}
+
+//------------------------------------------------------------------------------------------------------
+// tempo curves integration
+//------------------------------------------------------------------------------------------------------
+
+//NOTE(martin): the solvers of bezier elements derive their own tolerances from the element's tolerance. The residuals
+//              of x(s) = x and F(s) = target are scaled by the tempo (or its inverse) in the result, so we keep them
+//              a thousand times smaller. The quadrature error of each element adds up in the starts of the following
+//              elements, so we keep it a hundred times smaller.
+const f64 SCHED_CURVE_SOLVER_TOLERANCE_RATIO = 1e-3;
+const f64 SCHED_CURVE_QUADRATURE_TOLERANCE_RATIO = 1e-2;
+
+f64 sched_pos_tempo_integrate_over_time(sched_curve_elt* elt, f64 t)
+{
+	//NOTE(martin): do the integration for the remaining of time update in that element
+	//for now we consider that the curve is a linear patch and gives the scaling for a given position
+	f64 posUpdate = 0;
+	f64 C0 = elt->startValue;
+
+	switch(elt->type)
+	{
+		case SCHED_CURVE_CONST:
+		case SCHED_CURVE_STEP:
+		{
+			posUpdate = t*C0;
+		} break;
+
+		case SCHED_CURVE_LINEAR:
+		{
+			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
+			posUpdate = linear_pos_tempo_get_position(C0, alpha, t);
+		} break;
+
+		case SCHED_CURVE_BEZIER:
+		{
+			if(elt->quadrature == SCHED_CURVE_QUADRATURE_RKCK)
+			{
+				posUpdate = bezier_autonomous_tempo_get_position(&elt->coeffs, elt->tolerance, t);
+			}
+			else
+			{
+				bezier_integral integral = {.coeffs = &elt->coeffs,
+				                            .axes = SCHED_CURVE_POS_TEMPO,
+				                            .panelCount = elt->quadraturePanels,
+				                            .epsilon = elt->tolerance*SCHED_CURVE_SOLVER_TOLERANCE_RATIO};
+				f64 s = bezier_integral_invert(&integral, elt->transformedLength, t);
+				posUpdate = bezier_sample_x(&elt->coeffs, s);
+			}
+		} break;
+
+		case SCHED_CURVE_SAMPLED:
+		{
+			posUpdate = sched_curve_samples_inverse(elt->samples, SCHED_CURVE_POS_TEMPO, t);
+		} break;
+
+		case SCHED_CURVE_EXPONENTIAL:
+		{
+			posUpdate = log_ratio(-elt->rate, C0*t);
+		} break;
+
+		case SCHED_CURVE_POWER:
+		{
+			posUpdate = power_ratio_inverse(1 - elt->exponent, elt->rate, C0*t);
+		} break;
+	}
+	return(posUpdate);
+}
+
+f64 sched_pos_tempo_integrate_over_pos(sched_curve_elt* elt, f64 p)
+{
+	//NOTE(martin): do the integration for the remaining of pos update in that element
+	//for now we consider that the curve is a linear patch and gives the scaling for a given position
+	f64 timeUpdate = 0;
+	f64 C0 = elt->startValue;
+
+	switch(elt->type)
+	{
+		case SCHED_CURVE_CONST:
+		case SCHED_CURVE_STEP:
+		{
+			timeUpdate = p/C0;
+		} break;
+
+		case SCHED_CURVE_LINEAR:
+		{
+			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
+			timeUpdate = linear_pos_tempo_get_time(C0, alpha, p);
+		} break;
+
+		case SCHED_CURVE_BEZIER:
+		{
+			timeUpdate = bezier_autonomous_tempo_get_time(&elt->coeffs, elt->quadrature, elt->quadraturePanels, elt->tolerance, p);
+		} break;
+
+		case SCHED_CURVE_SAMPLED:
+		{
+			timeUpdate = sched_curve_samples_forward(elt->samples, SCHED_CURVE_POS_TEMPO, p);
+		} break;
+
+		case SCHED_CURVE_EXPONENTIAL:
+		{
+			timeUpdate = exp_ratio(-elt->rate, p)/C0;
+		} break;
+
+		case SCHED_CURVE_POWER:
+		{
+			timeUpdate = power_ratio(1 - elt->exponent, elt->rate, p)/C0;
+		} break;
+	}
+	return(timeUpdate);
+}
+
+f64 sched_time_tempo_integrate_over_time(sched_curve_elt* elt, f64 t)
+{
+	//NOTE(martin): do the integration for the remaining of time update in that element
+	//for now we consider that the curve is a linear patch and gives the scaling for a given position
+	f64 posUpdate = 0;
+	f64 C0 = elt->startValue;
+
+	switch(elt->type)
+	{
+		case SCHED_CURVE_CONST:
+		case SCHED_CURVE_STEP:
+		{
+			posUpdate = t*C0;
+		} break;
+
+		case SCHED_CURVE_LINEAR:
+		{
+			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
+			posUpdate = linear_time_tempo_get_position(C0, alpha, t);
+		} break;
+
+		case SCHED_CURVE_BEZIER:
+		{
+			posUpdate = bezier_tempo_get_position(&elt->coeffs, t);
+		} break;
+
+		case SCHED_CURVE_SAMPLED:
+		{
+			posUpdate = sched_curve_samples_forward(elt->samples, SCHED_CURVE_TIME_TEMPO, t);
+		} break;
+
+		case SCHED_CURVE_EXPONENTIAL:
+		{
+			posUpdate = C0*exp_ratio(elt->rate, t);
+		} break;
+
+		case SCHED_CURVE_POWER:
+		{
+			posUpdate = C0*power_ratio(1 + elt->exponent, elt->rate, t);
+		} break;
+	}
+	return(posUpdate);
+}
+
+f64 sched_time_tempo_integrate_over_pos(sched_curve_elt* elt, f64 p)
+{
+	//NOTE(martin): do the integration for the remaining of pos update in that element
+	//for now we consider that the curve is a linear patch and gives the scaling for a given position
+	f64 timeUpdate = 0;
+	f64 C0 = elt->startValue;
+
+	switch(elt->type)
+	{
+		case SCHED_CURVE_CONST:
+		case SCHED_CURVE_STEP:
+		{
+			timeUpdate = p/C0;
+		} break;
+
+		case SCHED_CURVE_LINEAR:
+		{
+			f64 alpha = (elt->endValue - elt->startValue)/elt->length; //TODO(martin): could precompute
+			timeUpdate = linear_time_tempo_get_time(C0, alpha, p);
+		} break;
+
+		case SCHED_CURVE_BEZIER:
+		{
+			if(elt->quadrature == SCHED_CURVE_QUADRATURE_RKCK)
+			{
+				timeUpdate = bezier_tempo_get_time(&elt->coeffs, elt->tolerance, p);
+			}
+			else
+			{
+				bezier_integral integral = {.coeffs = &elt->coeffs,
+				                            .axes = SCHED_CURVE_TIME_TEMPO,
+				                            .panelCount = 0,
+				                            .epsilon = elt->tolerance*SCHED_CURVE_SOLVER_TOLERANCE_RATIO};
+				f64 s = bezier_integral_invert(&integral, elt->transformedLength, p);
+				timeUpdate = bezier_sample_x(&elt->coeffs, s);
+			}
+		} break;
+
+		case SCHED_CURVE_SAMPLED:
+		{
+			timeUpdate = sched_curve_samples_inverse(elt->samples, SCHED_CURVE_TIME_TEMPO, p);
+		} break;
+
+		case SCHED_CURVE_EXPONENTIAL:
+		{
+			timeUpdate = log_ratio(elt->rate, p/C0);
+		} break;
+
+		case SCHED_CURVE_POWER:
+		{
+			timeUpdate = power_ratio_inverse(1 + elt->exponent, elt->rate, p/C0);
+		} break;
+	}
+	return(timeUpdate);
+}
+
+
+f64 sched_curve_elt_pos_from_time(sched_curve_axes axes, sched_curve_elt* elt, f64 t)
+{
+	return((axes == SCHED_CURVE_POS_TEMPO) ? sched_pos_tempo_integrate_over_time(elt, t) : sched_time_tempo_integrate_over_time(elt, t));
+}
+
+f64 sched_curve_elt_time_from_pos(sched_curve_axes axes, sched_curve_elt* elt, f64 p)
+{
+	return((axes == SCHED_CURVE_POS_TEMPO) ? sched_pos_tempo_integrate_over_pos(elt, p) : sched_time_tempo_integrate_over_pos(elt, p));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Chebyshev compilation
+//------------------------------------------------------------------------------------------------------
+
+typedef f64 (*sched_curve_elt_map)(sched_curve_axes axes, sched_curve_elt* elt, f64 x);
+
+const f64 SCHED_CURVE_CHEBYSHEV_ERROR_SAFETY = 2;
+
+f64 chebyshev_eval(const f64* coeffs, f64 u)
+{
+	//NOTE(martin): Clenshaw recurrence for sum(c_k * T_k(u)), with u in [-1, 1]
+	f64 b1 = 0;
+	f64 b2 = 0;
+	f64 u2 = 2*u;
+	for(int k=SCHED_CURVE_CHEBYSHEV_ORDER-1; k>0; k--)
+	{
+		f64 tmp = u2*b1 - b2 + coeffs[k];
+		b2 = b1;
+		b1 = tmp;
+	}
+	return(u*b1 - b2 + coeffs[0]);
+}
+
+f64 sched_curve_chebyshev_eval(sched_curve* curve, sched_curve_chebyshev* fit, f64 x)
+{
+	f64 u = ClampLowBound(x, 0.) * fit->pieceScale;
+	u32 piece = minimum((u32)u, fit->pieceCount-1);
+	const f64* coeffs = curve->chebyshevCoeffs + fit->offset + piece*SCHED_CURVE_CHEBYSHEV_ORDER;
+	return(chebyshev_eval(coeffs, ClampHighBound(2*(u - piece) - 1, 1.)));
+}
+
+void chebyshev_fit(sched_curve_axes axes, sched_curve_elt* elt, sched_curve_elt_map map, f64 a, f64 b, f64* coeffs)
+{
+	const u32 n = SCHED_CURVE_CHEBYSHEV_ORDER;
+	f64 center = 0.5*(a + b);
+	f64 halfWidth = 0.5*(b - a);
+
+	f64 values[SCHED_CURVE_CHEBYSHEV_ORDER];
+	for(u32 k=0; k<n; k++)
+	{
+		f64 node = cos(M_PI*(k + 0.5)/n);
+		values[k] = map(axes, elt, center + halfWidth*node);
+	}
+	for(u32 j=0; j<n; j++)
+	{
+		f64 sum = 0;
+		for(u32 k=0; k<n; k++)
+		{
+			sum += values[k]*cos(M_PI*j*(k + 0.5)/n);
+		}
+		coeffs[j] = sum*2/n;
+	}
+	coeffs[0] *= 0.5;
+}
+
+u32 sched_curve_push_coeffs(sched_curve* curve, const f64* coeffs, u32 count)
+{
+	//NOTE(martin): append coefficients to the curve's buffer, and return their offset
+	DEBUG_ASSERT(!curve->chebyshevCoeffsInline);
+	u32 offset = curve->chebyshevCoeffCount;
+	curve->chebyshevCoeffs = (f64*)realloc(curve->chebyshevCoeffs, (offset + count)*sizeof(f64));
+	memcpy(curve->chebyshevCoeffs + offset, coeffs, count*sizeof(f64));
+	curve->chebyshevCoeffCount += count;
+	return(offset);
+}
+
+bool sched_curve_compile_map(sched_curve* curve,
+                             sched_curve_elt* elt,
+                             sched_curve_elt_map map,
+                             f64 domain,
+                             f64 tolerance,
+                             sched_curve_chebyshev* fit)
+{
+	//NOTE(martin): double the number of pieces until the error is below the tolerance. The interpolation error peaks
+	//              near the extrema of T_n, so we measure it there and halfway between them, which is denser near the
+	//              ends of the piece. The measured error is then scaled by a safety factor to cover the error between the
+	//              checked points and the error of the exact integration itself, so that fit->error is an upper bound.
+	const u32 checkCount = 2*SCHED_CURVE_CHEBYSHEV_ORDER;
+	f64 coeffs[SCHED_CURVE_CHEBYSHEV_MAX_PIECES * SCHED_CURVE_CHEBYSHEV_ORDER];
+
+	memset(fit, 0, sizeof(sched_curve_chebyshev));
+
+	for(u32 pieceCount = 1; pieceCount <= SCHED_CURVE_CHEBYSHEV_MAX_PIECES; pieceCount *= 2)
+	{
+		f64 pieceWidth = domain/pieceCount;
+		f64 error = 0;
+		for(u32 piece=0; piece<pieceCount && error <= tolerance; piece++)
+		{
+			f64* pieceCoeffs = coeffs + piece*SCHED_CURVE_CHEBYSHEV_ORDER;
+			f64 a = piece*pieceWidth;
+			chebyshev_fit(curve->axes, elt, map, a, a + pieceWidth, pieceCoeffs);
+
+			for(u32 i=0; i<=checkCount; i++)
+			{
+				f64 u = cos(M_PI*i/checkCount);
+				f64 exact = map(curve->axes, elt, a + 0.5*(u + 1)*pieceWidth);
+				error = maximum(error, SCHED_CURVE_CHEBYSHEV_ERROR_SAFETY*fabs(chebyshev_eval(pieceCoeffs, u) - exact));
+			}
+		}
+		if(error <= tolerance)
+		{
+			fit->pieceCount = pieceCount;
+			fit->offset = sched_curve_push_coeffs(curve, coeffs, pieceCount*SCHED_CURVE_CHEBYSHEV_ORDER);
+			fit->domain = domain;
+			fit->pieceScale = pieceCount/domain;
+			fit->error = error;
+			return(true);
+		}
+	}
+	return(false);
+}
+
+void sched_curve_compile_elt(sched_curve* curve, u32 index)
+{
+	sched_curve_elt* elt = &(curve->elements[index]);
+
+	//NOTE(martin): const and linear elements have cheap closed forms, so we only compile bezier elements
+	if(elt->type != SCHED_CURVE_BEZIER)
+	{
+		return;
+	}
+	f64 timeLength = (curve->axes == SCHED_CURVE_POS_TEMPO) ? elt->transformedLength : elt->length;
+	f64 posLength = (curve->axes == SCHED_CURVE_POS_TEMPO) ? elt->length : elt->transformedLength;
+
+	bool posCompiled = sched_curve_compile_map(curve,
+	                                           elt,
+	                                           sched_curve_elt_pos_from_time,
+	                                           timeLength,
+	                                           curve->compileTolerance,
+	                                           &elt->posFromTime);
+
+	bool timeCompiled = sched_curve_compile_map(curve,
+	                                            elt,
+	                                            sched_curve_elt_time_from_pos,
+	                                            posLength,
+	                                            curve->compileTolerance,
+	                                            &elt->timeFromPos);
+	if(!posCompiled || !timeCompiled)
+	{
+		LOG_WARNING("couldn't compile element %i within tolerance, falling back to exact integration\n", index);
+	}
+}
+
+void sched_curve_update_compile_report(sched_curve* curve)
+{
+	sched_curve_compile_report* report = &curve->compileReport;
+	memset(report, 0, sizeof(sched_curve_compile_report));
+
+	if(!curve->compile)
+	{
+		return;
+	}
+	for(u32 i=0; i<curve->eltCount; i++)
+	{
+		sched_curve_elt* elt = &(curve->elements[i]);
+		if(elt->type != SCHED_CURVE_BEZIER)
+		{
+			continue;
+		}
+		if(elt->posFromTime.pieceCount && elt->timeFromPos.pieceCount)
+		{
+			report->compiledEltCount++;
+		}
+		else
+		{
+			report->fallbackEltCount++;
+		}
+		if(elt->posFromTime.pieceCount)
+		{
+			report->maxPosError = maximum(report->maxPosError, elt->posFromTime.error);
+		}
+		if(elt->timeFromPos.pieceCount)
+		{
+			report->maxTimeError = maximum(report->maxTimeError, elt->timeFromPos.error);
+		}
+	}
+	report->coeffCount = curve->chebyshevCoeffCount;
+}
+
+void sched_curve_get_compile_report(sched_curve* curve, sched_curve_compile_report* report)
+{
+	*report = curve->compileReport;
+}
+
+//------------------------------------------------------------------------------------------------------
+// curves create/destroy
+//------------------------------------------------------------------------------------------------------
+
+#define sched_curve_elt_start_time(curve, elt) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->transformedStart : elt->start)
+
+#define sched_curve_elt_start_pos(curve, elt) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->start : elt->transformedStart)
+
+#define sched_curve_elt_end_time(curve, elt) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->transformedEnd : elt->end)
+
+#define sched_curve_elt_end_pos(curve, elt) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->end : elt->transformedEnd)
+
+const f64 SCHED_CURVE_PRECISE_TOLERANCE = 1e-9;
+const f64 SCHED_CURVE_FAST_TOLERANCE = 1e-4;
+
+#define sched_curve_primary_starts(curve) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? curve->eltStartPositions : curve->eltStartTimes)
+
+#define sched_curve_transformed_starts(curve) \
+	((curve->axes == SCHED_CURVE_POS_TEMPO)? curve->eltStartTimes : curve->eltStartPositions)
+
+int sched_curve_elt_init(sched_curve* curve, sched_curve_elt* elt, sched_curve_descriptor_elt* descElt)
+{
+	//NOTE(martin): initialize an element from its descriptor. This doesn't integrate it nor set its start and end.
+	elt->type = descElt->type;
+	elt->posFromTime.pieceCount = 0;
+	elt->timeFromPos.pieceCount = 0;
+	elt->samples = 0;
+	elt->startValue = descElt->startValue;
+	elt->endValue = descElt->endValue;
+	elt->length = descElt->length;
+
+	if(elt->type == SCHED_CURVE_SAMPLED)
+	{
+		//NOTE(martin): the samples are validated when creating the tables, and give the values and length of the element
+		elt->samples = sched_curve_samples_create(curve->axes, descElt);
+		if(!elt->samples)
+		{
+			return(-3);
+		}
+		u32 last = elt->samples->count-1;
+		elt->startValue = elt->samples->values[0];
+		elt->endValue = elt->samples->values[last];
+		elt->length = sched_curve_samples_offset(elt->samples, last);
+		return(0);
+	}
+
+	if(elt->length == 0 && elt->type != SCHED_CURVE_CONST)
+	{
+		LOG_ERROR("non-const zero length element in curve descriptor\n");
+		return(-1);
+	}
+	if(elt->startValue <= 0 || (elt->endValue <= 0 && elt->type != SCHED_CURVE_CONST))
+	{
+		LOG_ERROR("negative or null tempo in curve descriptor\n");
+		return(-2);
+	}
+
+	switch(elt->type)
+	{
+		case SCHED_CURVE_CONST:
+			elt->endValue = elt->startValue;
+			break;
+
+		case SCHED_CURVE_EXPONENTIAL:
+			elt->rate = log(elt->endValue/elt->startValue)/elt->length;
+			break;
+
+		case SCHED_CURVE_POWER:
+		{
+			elt->exponent = descElt->exponent;
+			elt->rate = expm1(log(elt->endValue/elt->startValue)/elt->exponent)/elt->length;
+			if(elt->exponent == 0 || !isfinite(elt->rate))
+			{
+				LOG_ERROR("invalid exponent for power element in curve descriptor\n");
+				return(-3);
+			}
+		} break;
+
+		case SCHED_CURVE_BEZIER:
+		{
+			//TODO(martin): check control points constraints !
+			f64 p0x = 0;
+			f64 p0y = elt->startValue;
+			f64 p1x = descElt->p1x * elt->length;
+			f64 p1y = descElt->p1y * (elt->endValue-elt->startValue) + elt->startValue;
+			f64 p2x = descElt->p2x * elt->length;
+			f64 p2y = descElt->p2y * (elt->endValue-elt->startValue) + elt->startValue;
+			f64 p3x = elt->length;
+			f64 p3y = elt->endValue;
+
+			bezier_coeffs_init_with_control_points(&elt->coeffs, p0x, p0y, p1x, p1y, p2x, p2y, p3x, p3y);
+			elt->coeffs.xTolerance = curve->tolerance*SCHED_CURVE_SOLVER_TOLERANCE_RATIO;
+
+			elt->quadrature = curve->quadrature;
+			elt->tolerance = curve->tolerance;
+			elt->quadraturePanels = 0;
+		} break;
+
+		//TODO(martin): precompute slope for linear elements
+		default:
+			break;
+	}
+	return(0);
+}
+
+void sched_curve_elt_set_start(sched_curve* curve, u32 index, f64 start)
+{
+	//NOTE(martin): set the start and end of an element on the curve's main axis
+	sched_curve_elt* elt = &(curve->elements[index]);
+	elt->start = start;
+	elt->end = start + elt->length;
+
+	f64* starts = sched_curve_primary_starts(curve);
+	starts[index] = start;
+	starts[index+1] = elt->end;
+}
+
+void sched_curve_elt_integrate(sched_curve* curve, u32 index)
+{
+	//NOTE(martin): integrate an element whose predecessors are integrated, and set its transformed start and end
+	sched_curve_elt* elt = &(curve->elements[index]);
+
+	if(elt->type == SCHED_CURVE_BEZIER
+	   && curve->axes == SCHED_CURVE_POS_TEMPO
+	   && curve->quadrature == SCHED_CURVE_QUADRATURE_GAUSS)
+	{
+		elt->quadraturePanels = gauss_legendre_select_panel_count(0, 1,
+		                                                          bezier_autonomous_tempo_get_time_callback,
+		                                                          (void*)&elt->coeffs,
+		                                                          elt->tolerance*SCHED_CURVE_QUADRATURE_TOLERANCE_RATIO);
+	}
+
+	//TODO(martin): hoist that up ?
+	switch(curve->axes)
+	{
+		case SCHED_CURVE_POS_TEMPO:
+			elt->transformedLength = sched_pos_tempo_integrate_over_pos(elt, elt->length);
+			break;
+		case SCHED_CURVE_TIME_TEMPO:
+			elt->transformedLength = sched_time_tempo_integrate_over_time(elt, elt->length);
+			break;
+	}
+	elt->transformedStart = index ? curve->elements[index-1].transformedEnd : 0;
+	elt->transformedEnd = elt->transformedStart + elt->transformedLength;
+
+	//NOTE(martin): starts[index] was already set by the previous element, or by sched_curve_set_unintegrated(), and
+	//              may be read concurrently by queries on a lazy curve, so we only write the element's end.
+	f64* starts = sched_curve_transformed_starts(curve);
+	starts[index+1] = elt->transformedEnd;
+}
+
+void sched_curve_set_unintegrated(sched_curve* curve, u32 integratedCount)
+{
+	//NOTE(martin): mark the elements after integratedCount as not integrated yet. Their transformed starts are set
+	//              to +infinity, so that the starts arrays stay sorted and searches don't need to know about lazy curves.
+	f64* starts = sched_curve_transformed_starts(curve);
+	if(!integratedCount)
+	{
+		starts[0] = 0;
+	}
+	for(u32 i=integratedCount+1; i<=curve->eltCount; i++)
+	{
+		starts[i] = INFINITY;
+	}
+	curve->integratedCount = integratedCount;
+}
+
+void sched_curve_integrate_until(sched_curve* curve, const f64* starts, f64 x)
+{
+	//NOTE(martin): integrate the elements of a lazy curve until the element containing x, on the axis of starts, is
+	//              integrated. We take the lock for each element, so that a concurrent query never waits for more
+	//              than one element.
+	bool done = false;
+	while(!done)
+	{
+		TicketSpinMutexLock(&curve->integrationMutex);
+		{
+			u32 count = curve->integratedCount;
+			done = (count == curve->eltCount) || (count && starts[count] >= x);
+			if(!done)
+			{
+				sched_curve_elt_integrate(curve, count);
+				curve->integratedCount = count + 1;
+			}
+		} TicketSpinMutexUnlock(&curve->integrationMutex);
+	}
+}
+
+inline void sched_curve_require(sched_curve* curve, const f64* starts, f64 x)
+{
+	//NOTE(martin): make sure the element containing x is integrated before a query reads it. starts[count] is valid
+	//              on both axes, since the elements before count are integrated.
+	u32 count = curve->integratedCount;
+	if(count < curve->eltCount && (!count || starts[count] < x))
+	{
+		sched_curve_integrate_until(curve, starts, x);
+	}
+}
+
+inline u32 sched_curve_published_count(sched_curve* curve)
+{
+	//NOTE(martin): number of element ends that queries can search. On a lazy curve, the entries after integratedCount
+	//              can be written concurrently by the thread integrating the next element, so queries treat them as
+	//              +infinity and never read them. This must be loaded after sched_curve_require().
+	return(curve->integratedCount);
+}
+
+int sched_curve_replace(sched_curve* curve, sched_curve_descriptor* descriptor)
+{
+	//NOTE(martin): recompute the whole curve from descriptor
+	curve->axes = descriptor->axes;
+	curve->quadrature = descriptor->quadrature;
+	if(descriptor->tolerance > 0)
+	{
+		curve->tolerance = descriptor->tolerance;
+	}
+	else
+	{
+		curve->tolerance = (descriptor->profile == SCHED_CURVE_PROFILE_FAST) ? SCHED_CURVE_FAST_TOLERANCE : SCHED_CURVE_PRECISE_TOLERANCE;
+	}
+	curve->lazy = descriptor->lazy;
+	curve->compile = descriptor->compile;
+	curve->compileTolerance = (descriptor->compileTolerance > 0) ? descriptor->compileTolerance : curve->tolerance;
+	curve->eltCount = descriptor->eltCount;
+	TicketSpinMutexInit(&curve->integrationMutex);
+
+	if(curve->lazy && curve->compile)
+	{
+		LOG_WARNING("lazy curves can't be compiled, using exact integration\n");
+		curve->compile = false;
+	}
+
+	if(!curve->chebyshevCoeffsInline)
+	{
+		free(curve->chebyshevCoeffs);
+	}
+	curve->chebyshevCoeffs = 0;
+	curve->chebyshevCoeffCount = 0;
+	curve->chebyshevCoeffsInline = false;
+
+	//NOTE(martin): initialize elements with descriptor elements, and precompute breakpoints values
+	f64 start = 0;
+	sched_curve_primary_starts(curve)[0] = 0;
+
+	for(int i=0; i<descriptor->eltCount; i++)
+	{
+		sched_curve_elt* elt = &(curve->elements[i]);
+		int err = sched_curve_elt_init(curve, elt, &(descriptor->elements[i]));
+		if(err)
+		{
+			//NOTE(martin): only keep the initialized elements, so that the curve can be released
+			curve->eltCount = i;
+			return(err);
+		}
+		sched_curve_elt_set_start(curve, i, start);
+		start = elt->end;
+	}
+
+	sched_curve_set_unintegrated(curve, 0);
+	if(!curve->lazy)
+	{
+		for(u32 i=0; i<curve->eltCount; i++)
+		{
+			sched_curve_elt_integrate(curve, i);
+		}
+		curve->integratedCount = curve->eltCount;
+	}
+
+	if(curve->compile)
+	{
+		for(u32 i=0; i<curve->eltCount; i++)
+		{
+			sched_curve_compile_elt(curve, i);
+		}
+	}
+	sched_curve_update_compile_report(curve);
+	return(0);
+}
+
+u64 sched_curve_block_size(u32 eltCount)
+{
+	return(sizeof(sched_curve) + sizeof(sched_curve_elt) * eltCount + 2 * sizeof(f64) * (eltCount + 1));
+}
+
+void sched_curve_set_block_pointers(sched_curve* curve, u32 eltCount)
+{
+	curve->elements = (sched_curve_elt*)(((char*)curve) + sizeof(sched_curve));
+	curve->eltStartTimes = (f64*)(curve->elements + eltCount);
+	curve->eltStartPositions = curve->eltStartTimes + eltCount + 1;
+}
+
+sched_curve* sched_curve_pack(sched_curve* curve)
+{
+	//NOTE(martin): move the Chebyshev coefficients at the end of the curve block, so that all the data used by queries
+	//              is in a single allocation.
+	if(!curve->chebyshevCoeffCount || curve->chebyshevCoeffsInline)
+	{
+		return(curve);
+	}
+	u64 baseSize = sched_curve_block_size(curve->eltCount);
+	f64* coeffs = curve->chebyshevCoeffs;
+
+	curve = (sched_curve*)realloc(curve, baseSize + curve->chebyshevCoeffCount * sizeof(f64));
+	sched_curve_set_block_pointers(curve, curve->eltCount);
+	curve->chebyshevCoeffs = (f64*)(((char*)curve) + baseSize);
+	curve->chebyshevCoeffsInline = true;
+
+	memcpy(curve->chebyshevCoeffs, coeffs, curve->chebyshevCoeffCount * sizeof(f64));
+	free(coeffs);
+	return(curve);
+}
+
+sched_curve* sched_curve_create(sched_curve_descriptor* descriptor)
+{
+	u32 eltCount = descriptor->eltCount;
+	sched_curve* curve = (sched_curve*)malloc(sched_curve_block_size(eltCount));
+	sched_curve_set_block_pointers(curve, eltCount);
+	curve->refCount = 1;
+	curve->eltCount = eltCount;
+	curve->chebyshevCoeffCount = 0;
+	curve->chebyshevCoeffs = 0;
+	curve->chebyshevCoeffsInline = false;
+
+	if(sched_curve_replace(curve, descriptor))
+	{
+		sched_curve_release(curve);
+		return(0);
+	}
+	else
+	{
+		return(sched_curve_pack(curve));
+	}
+}
+
+sched_curve* sched_curve_retain(sched_curve* curve)
+{
+	curve->refCount++;
+	return(curve);
+}
+
+void sched_curve_release(sched_curve* curve)
+{
+	DEBUG_ASSERT(curve->refCount);
+	if(--curve->refCount == 0)
+	{
+		if(!curve->chebyshevCoeffsInline)
+		{
+			free(curve->chebyshevCoeffs);
+		}
+		for(u32 i=0; i<curve->eltCount; i++)
+		{
+			if(curve->elements[i].samples)
+			{
+				sched_curve_samples_release(curve->elements[i].samples);
+			}
+		}
+		free(curve);
+	}
+}
+
+void sched_curve_destroy(sched_curve* curve)
+{
+	sched_curve_release(curve);
+}
+
+//------------------------------------------------------------------------------------------------------
+// curves edits
+//------------------------------------------------------------------------------------------------------
+
+u32 sched_curve_copy_fit(sched_curve* curve, sched_curve* source, sched_curve_chebyshev* fit, u32 offset)
+{
+	//NOTE(martin): copy the coefficients of a fit from the source curve at offset in the curve's buffer, and return
+	//              the offset following them.
+	if(fit->pieceCount)
+	{
+		u32 count = fit->pieceCount * SCHED_CURVE_CHEBYSHEV_ORDER;
+		memcpy(curve->chebyshevCoeffs + offset, source->chebyshevCoeffs + fit->offset, count*sizeof(f64));
+		fit->offset = offset;
+		offset += count;
+	}
+	return(offset);
+}
+
+void sched_curve_retain_samples(sched_curve* curve, u32 first, u32 end)
+{
+	//NOTE(martin): copied elements share the sample tables of the source curve
+	for(u32 i=first; i<end; i++)
+	{
+		if(curve->elements[i].samples)
+		{
+			sched_curve_samples_retain(curve->elements[i].samples);
+		}
+	}
+}
+
+sched_curve* sched_curve_replace_range(sched_curve* curve,
+                                       u32 first,
+                                       u32 count,
+                                       u32 eltCount,
+                                       sched_curve_descriptor_elt* elements)
+{
+	//NOTE(martin): build a new curve where elements [first, first+count) of the source curve are replaced by the given
+	//              elements. Only the new elements are integrated (and compiled): the elements before the range are
+	//              copied as is, and the elements after the range are copied and shifted by the difference between
+	//              the old and new end of the range.
+	//              For lazy curves, the new elements and the suffix are left to be integrated when queries reach them.
+	if(first > curve->eltCount || count > curve->eltCount - first)
+	{
+		LOG_ERROR("curve edit range [%u, %u) is out of bounds (curve has %u elements)\n", first, first+count, curve->eltCount);
+		return(0);
+	}
+	u32 suffixStart = first + count;
+	u32 suffixCount = curve->eltCount - suffixStart;
+	u32 newCount = first + eltCount + suffixCount;
+	if(!newCount)
+	{
+		LOG_ERROR("curve edit would leave an empty curve\n");
+		return(0);
+	}
+
+	sched_curve* result = (sched_curve*)malloc(sched_curve_block_size(newCount));
+	sched_curve_set_block_pointers(result, newCount);
+	result->refCount = 1;
+	result->axes = curve->axes;
+	result->quadrature = curve->quadrature;
+	result->tolerance = curve->tolerance;
+	result->lazy = curve->lazy;
+	result->compile = curve->compile;
+	result->compileTolerance = curve->compileTolerance;
+	result->eltCount = newCount;
+	result->chebyshevCoeffCount = 0;
+	result->chebyshevCoeffs = 0;
+	result->chebyshevCoeffsInline = false;
+	TicketSpinMutexInit(&result->integrationMutex);
+
+	//NOTE(martin): copy the prefix. The source curve can be integrated concurrently, so we only rely on the elements
+	//              that were integrated when we read its watermark.
+	u32 integratedCount = minimum(first, (u32)curve->integratedCount);
+
+	memcpy(result->elements, curve->elements, first*sizeof(sched_curve_elt));
+	sched_curve_retain_samples(result, 0, first);
+	memcpy(sched_curve_primary_starts(result), sched_curve_primary_starts(curve), (first+1)*sizeof(f64));
+	memcpy(sched_curve_transformed_starts(result), sched_curve_transformed_starts(curve), (integratedCount+1)*sizeof(f64));
+
+	//NOTE(martin): initialize the new elements
+	f64 start = sched_curve_primary_starts(curve)[first];
+	for(u32 i=0; i<eltCount; i++)
+	{
+		u32 index = first + i;
+		sched_curve_elt* elt = &(result->elements[index]);
+		if(sched_curve_elt_init(result, elt, &(elements[i])))
+		{
+			//NOTE(martin): only keep the initialized elements, so that the curve can be released
+			result->eltCount = index;
+			sched_curve_release(result);
+			return(0);
 		}
-		if(elt->startValue <= 0 || (elt->endValue <= 0 && elt->type != SCHED_CURVE_CONST))
+		sched_curve_elt_set_start(result, index, start);
+		start = elt->end;
+	}
+
+	//NOTE(martin): copy and shift the suffix
+	u32 suffixOffset = first + eltCount;
+	if(suffixCount)
+	{
+		f64 shift = start - curve->elements[suffixStart].start;
+		memcpy(result->elements + suffixOffset, curve->elements + suffixStart, suffixCount*sizeof(sched_curve_elt));
+		sched_curve_retain_samples(result, suffixOffset, newCount);
+
+		for(u32 index = suffixOffset; index < newCount; index++)
 		{
-			LOG_ERROR("negative or null tempo in curve descriptor\n");
-			return(-2);
+			sched_curve_elt* elt = &(result->elements[index]);
+			sched_curve_elt_set_start(result, index, elt->start + shift);
 		}
+	}
 
-		switch(elt->type)
+	if(result->lazy)
+	{
+		sched_curve_set_unintegrated(result, integratedCount);
+	}
+	else
+	{
+		//NOTE(martin): integrate the new elements, and shift the transformed starts of the suffix
+		for(u32 index=first; index<suffixOffset; index++)
+		{
+			sched_curve_elt_integrate(result, index);
+		}
+		if(suffixCount)
 		{
-			case SCHED_CURVE_CONST:
-				elt->endValue = elt->startValue;
-				break;
+			f64 transformedShift = (suffixOffset ? result->elements[suffixOffset-1].transformedEnd : 0)
+			                     - curve->elements[suffixStart].transformedStart;
 
-			case SCHED_CURVE_BEZIER:
+			f64* starts = sched_curve_transformed_starts(result);
+			for(u32 index = suffixOffset; index < newCount; index++)
 			{
-				//TODO(martin): check control points constraints !
-				f64 p0x = 0;
-				f64 p0y = elt->startValue;
-				f64 p1x = descElt->p1x * elt->length;
-				f64 p1y = descElt->p1y * (elt->endValue-elt->startValue) + elt->startValue;
-				f64 p2x = descElt->p2x * elt->length;
-				f64 p2y = descElt->p2y * (elt->endValue-elt->startValue) + elt->startValue;
-				f64 p3x = elt->length;
-				f64 p3y = elt->endValue;
-
-				bezier_coeffs_init_with_control_points(&elt->coeffs, p0x, p0y, p1x, p1y, p2x, p2y, p3x, p3y);
-			} break;
-
-			//TODO(martin): precompute slope for linear elements
-			default:
-				break;
-		}
-		//TODO(martin): hoist that up ?
-		switch(curve->axes)
-		{
-			case SCHED_CURVE_POS_TEMPO:
-				elt->transformedLength = sched_pos_tempo_integrate_over_pos(elt, elt->length);
-				break;
-			case SCHED_CURVE_TIME_TEMPO:
-				elt->transformedLength = sched_time_tempo_integrate_over_time(elt, elt->length);
-				break;
-		}
-		elt->start = start;
-		elt->transformedStart = transformedStart;
-		elt->end = start + elt->length;
-		elt->transformedEnd = transformedStart + elt->transformedLength;
+				sched_curve_elt* elt = &(result->elements[index]);
+				elt->transformedStart += transformedShift;
+				elt->transformedEnd += transformedShift;
+				starts[index] = elt->transformedStart;
+				starts[index+1] = elt->transformedEnd;
+			}
+		}
+		result->integratedCount = newCount;
+	}
 
-		start = elt->end;
-		transformedStart = elt->transformedEnd;
+	//NOTE(martin): copy the approximations of the old elements in a single allocation, and compile the new ones
+	if(result->compile)
+	{
+		u32 copiedCount = 0;
+		for(u32 index=0; index<newCount; index++)
+		{
+			if(index < first || index >= suffixOffset)
+			{
+				sched_curve_elt* elt = &(result->elements[index]);
+				copiedCount += (elt->posFromTime.pieceCount + elt->timeFromPos.pieceCount) * SCHED_CURVE_CHEBYSHEV_ORDER;
+			}
+		}
+		if(copiedCount)
+		{
+			result->chebyshevCoeffs = (f64*)malloc(copiedCount*sizeof(f64));
+			result->chebyshevCoeffCount = copiedCount;
+		}
+		u32 offset = 0;
+		for(u32 index=0; index<newCount; index++)
+		{
+			if(index < first || index >= suffixOffset)
+			{
+				offset = sched_curve_copy_fit(result, curve, &(result->elements[index].posFromTime), offset);
+				offset = sched_curve_copy_fit(result, curve, &(result->elements[index].timeFromPos), offset);
+			}
+		}
+		for(u32 index=first; index<suffixOffset; index++)
+		{
+			sched_curve_compile_elt(result, index);
+		}
 	}
-	return(0);
+	sched_curve_update_compile_report(result);
+	return(sched_curve_pack(result));
 }
 
-sched_curve* sched_curve_create(sched_curve_descriptor* descriptor)
+sched_curve* sched_curve_append(sched_curve* curve, u32 eltCount, sched_curve_descriptor_elt* elements)
 {
-	sched_curve* curve = (sched_curve*)malloc(sizeof(sched_curve) + sizeof(sched_curve_elt) * descriptor->eltCount);
-	curve->elements = (sched_curve_elt*)(((char*)curve) + sizeof(sched_curve));
-	curve->eltCount = descriptor->eltCount;
+	return(sched_curve_replace_range(curve, curve->eltCount, 0, eltCount, elements));
+}
 
-	if(sched_curve_replace(curve, descriptor))
+sched_curve* sched_curve_truncate(sched_curve* curve, u32 eltCount)
+{
+	if(eltCount > curve->eltCount)
 	{
-		sched_curve_destroy(curve);
+		LOG_ERROR("can't truncate a curve of %u elements to %u elements\n", curve->eltCount, eltCount);
 		return(0);
 	}
-	else
-	{
-		return(curve);
-	}
-}
-
-void sched_curve_destroy(sched_curve* curve)
-{
-	free(curve);
+	return(sched_curve_replace_range(curve, eltCount, curve->eltCount - eltCount, 0, 0));
 }
 
 //------------------------------------------------------------------------------------------------------
 // find curve element for time/pos in a curve
 //------------------------------------------------------------------------------------------------------
 
-#define sched_curve_elt_start_time(curve, elt) \
-	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->transformedStart : elt->start)
-
-#define sched_curve_elt_start_pos(curve, elt) \
-	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->start : elt->transformedStart)
-
-#define sched_curve_elt_end_time(curve, elt) \
-	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->transformedEnd : elt->end)
-
-#define sched_curve_elt_end_pos(curve, elt) \
-	((curve->axes == SCHED_CURVE_POS_TEMPO)? elt->end : elt->transformedEnd)
+//NOTE(martin): both searches return the index of the first element whose end is greater or equal to x, or count if
+//              there is none. ends are the count element ends, ie. eltStartTimes+1 or eltStartPositions+1.
+//              Since the ends are sorted, this is also the number of ends that are less than x.
 
+u32 sched_curve_search_binary(const f64* ends, u32 count, f64 x)
+{
+	//NOTE(martin): branchless binary search. The comparison result is used as a multiplier rather than a branch,
+	//              so that the loop compiles to conditional moves and doesn't suffer from mispredictions.
+	if(!count)
+	{
+		return(0);
+	}
+	const f64* base = ends;
+	u32 len = count;
+	while(len > 1)
+	{
+		u32 half = len/2;
+		base += (base[half-1] < x) * half;
+		len -= half;
+	}
+	return((base - ends) + (*base < x));
+}
 
-sched_curve_elt* sched_curve_find_element_for_time(sched_curve* curve, f64 time, f64* outStartTime, f64* outStartPos)
+u32 sched_curve_search_probe(const f64* ends, u32 count, f64 x)
 {
-	//TODO could return status of which side we were on if outside the curve ?
-	f64 eltStartPos = 0;
-	f64 eltStartTime = 0;
-	sched_curve_elt* foundElt = 0;
+	//NOTE(martin): linear probe counting the ends that are less than x, two at a time with SSE2
+	u32 index = 0;
+	u32 i = 0;
+	#if defined(__SSE2__)
+		__m128d vx = _mm_set1_pd(x);
+		for(; i+2 <= count; i+=2)
+		{
+			int mask = _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(ends + i), vx));
+			index += (mask & 1) + (mask >> 1);
+		}
+	#endif
+	for(; i<count; i++)
+	{
+		index += (ends[i] < x);
+	}
+	return(index);
+}
 
-	//WARN(martin): the loop is done on a temporary element (elt) instead of directly on foundElt.
-	//              this is so that we can return a 0 elt if no matching interval was found,
-	//              but still correctly return last starting positions and time.
-	//              So don't iterate directly on foundElt because that would introduce a (not so) subtle bug !
-	//              That seems stupid, but eerf... been there, done that.
+const u32 SCHED_CURVE_PROBE_MAX_ELT_COUNT = 8;
 
-	u32 eltCount = curve->eltCount;
-	for(int i=0; i<eltCount; i++)
+u32 sched_curve_search(const f64* ends, u32 count, f64 x)
+{
+	if(count <= SCHED_CURVE_PROBE_MAX_ELT_COUNT)
 	{
-		sched_curve_elt* elt = &(curve->elements[i]);
-		f64 eltEndTime = sched_curve_elt_end_time(curve, elt);
-		if(eltEndTime >= time)
-		{
-			//NOTE(martin): since elements are contiguous and sorted, we pick the first whose end
-			//              is greater or equal to time
-			foundElt = elt;
-			break;
-		}
-		eltStartPos = sched_curve_elt_end_pos(curve, elt);
-		eltStartTime = sched_curve_elt_end_time(curve, elt);
+		return(sched_curve_search_probe(ends, count, x));
+	}
+	else
+	{
+		return(sched_curve_search_binary(ends, count, x));
 	}
-	*outStartPos = eltStartPos;
-	*outStartTime = eltStartTime;
-	return(foundElt);
+}
+
+sched_curve_elt* sched_curve_find_element_for_time(sched_curve* curve, f64 time, f64* outStartTime, f64* outStartPos)
+{
+	//NOTE(martin): if no element was found, we return 0 but still set the start values to the end of the curve
+	sched_curve_require(curve, curve->eltStartTimes, time);
+	u32 index = sched_curve_search(curve->eltStartTimes + 1, sched_curve_published_count(curve), time);
+	*outStartTime = curve->eltStartTimes[index];
+	*outStartPos = curve->eltStartPositions[index];
+	return((index < curve->eltCount) ? &(curve->elements[index]) : 0);
 }
 
 sched_curve_elt* sched_curve_find_element_for_pos(sched_curve* curve, f64 pos, f64* outStartTime, f64* outStartPos)
 {
-	f64 eltStartPos = 0;
-	f64 eltStartTime = 0;
-	sched_curve_elt* foundElt = 0;
+	sched_curve_require(curve, curve->eltStartPositions, pos);
+	u32 index = sched_curve_search(curve->eltStartPositions + 1, sched_curve_published_count(curve), pos);
+	*outStartTime = curve->eltStartTimes[index];
+	*outStartPos = curve->eltStartPositions[index];
+	return((index < curve->eltCount) ? &(curve->elements[index]) : 0);
+}
 
-	u32 eltCount = curve->eltCount;
-	for(int i=0; i<eltCount; i++)
-	{
-		sched_curve_elt* elt = &(curve->elements[i]);
-		f64 eltEndPos = sched_curve_elt_end_pos(curve, elt);
-		if(eltEndPos >= pos)
-		{
-			//NOTE(martin): since elements are contiguous and sorted, we pick the first whose end
-			//              is greater or equal to time
-			foundElt = elt;
-			break;
-		}
-		eltStartPos = sched_curve_elt_end_pos(curve, elt);
-		eltStartTime = sched_curve_elt_end_time(curve, elt);
-	}
-	*outStartPos = eltStartPos;
-	*outStartTime = eltStartTime;
-	return(foundElt);
+f64 sched_curve_prewarm(sched_curve* curve, f64 time)
+{
+	sched_curve_require(curve, curve->eltStartTimes, time);
+	return(curve->eltStartTimes[curve->integratedCount]);
+}
+
+bool sched_curve_is_integrated(sched_curve* curve)
+{
+	return(curve->integratedCount == curve->eltCount);
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -1030,19 +2472,13 @@ int sched_curve_get_position_from_time(sched_curve* curve, f64 time, f64* outPos
 		//NOTE(martin): do the integration for the remaining of time update in that element
 		f64 t = time - eltStartTime;
 
-		switch(curve->axes)
+		if(elt->posFromTime.pieceCount)
 		{
-			case SCHED_CURVE_POS_TEMPO:
-			{
-				f64 update = sched_pos_tempo_integrate_over_time(elt, t);
-				*outPos = eltStartPos + update;
-			} break;
-
-			case SCHED_CURVE_TIME_TEMPO:
-			{
-				f64 update = sched_time_tempo_integrate_over_time(elt, t);
-				*outPos = eltStartPos + update;
-			} break;
+			*outPos = eltStartPos + sched_curve_chebyshev_eval(curve, &elt->posFromTime, t);
+		}
+		else
+		{
+			*outPos = eltStartPos + sched_curve_elt_pos_from_time(curve->axes, elt, t);
 		}
 		return(0);
 	}
@@ -1070,22 +2506,358 @@ int sched_curve_get_time_from_position(sched_curve* curve, f64 pos, f64* outTime
 		//NOTE(martin): do the integration for the remaining of pos update in that element
 		f64 p = pos - eltStartPos;
 
-		switch(curve->axes)
+		if(elt->timeFromPos.pieceCount)
 		{
-			case SCHED_CURVE_POS_TEMPO:
-			{
-				f64 update = sched_pos_tempo_integrate_over_pos(elt, p);
-				*outTime = eltStartTime + update;
-			} break;
+			*outTime = eltStartTime + sched_curve_chebyshev_eval(curve, &elt->timeFromPos, p);
+		}
+		else
+		{
+			*outTime = eltStartTime + sched_curve_elt_time_from_pos(curve->axes, elt, p);
+		}
+		return(0);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// batch conversions kernels
+//------------------------------------------------------------------------------------------------------
+
+//NOTE(martin): kernels for the closed forms that only need arithmetic and square roots, with x = in[i] - inStart:
+//                - affine:    out[i] = outStart + slope*x                      (const elements, end of the curve)
+//                - quadratic: out[i] = outStart + C0*x + alpha/2*x^2           (linear time-tempo, pos from time)
+//                - sqrt:      out[i] = outStart + (sqrt(C0^2 + 2*alpha*x) - C0)/alpha (linear time-tempo, time from pos)
+//              The exp/log forms of linear position-tempo elements stay scalar.
+
+typedef void (*sched_curve_kernel_affine)(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 slope);
+typedef void (*sched_curve_kernel_linear)(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 C0, f64 alpha);
+
+void sched_curve_kernel_affine_scalar(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 slope)
+{
+	for(u32 i=0; i<count; i++)
+	{
+		out[i] = outStart + (in[i] - inStart)*slope;
+	}
+}
+
+void sched_curve_kernel_quadratic_scalar(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 C0, f64 alpha)
+{
+	f64 halfAlpha = 0.5*alpha;
+	for(u32 i=0; i<count; i++)
+	{
+		f64 t = in[i] - inStart;
+		out[i] = outStart + t*(C0 + halfAlpha*t);
+	}
+}
+
+void sched_curve_kernel_sqrt_scalar(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 C0, f64 alpha)
+{
+	f64 C02 = C0*C0;
+	f64 invAlpha = 1./alpha;
+	for(u32 i=0; i<count; i++)
+	{
+		f64 p = in[i] - inStart;
+		out[i] = outStart + (sqrt(C02 + 2*alpha*p) - C0)*invAlpha;
+	}
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2,fma")))
+void sched_curve_kernel_affine_avx2(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 slope)
+{
+	__m256d a = _mm256_set1_pd(inStart);
+	__m256d b = _mm256_set1_pd(outStart);
+	__m256d k = _mm256_set1_pd(slope);
+	u32 i = 0;
+	for(; i+4 <= count; i+=4)
+	{
+		__m256d x = _mm256_sub_pd(_mm256_loadu_pd(in + i), a);
+		_mm256_storeu_pd(out + i, _mm256_fmadd_pd(x, k, b));
+	}
+	sched_curve_kernel_affine_scalar(in + i, out + i, count - i, inStart, outStart, slope);
+}
+
+__attribute__((target("avx2,fma")))
+void sched_curve_kernel_quadratic_avx2(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 C0, f64 alpha)
+{
+	__m256d a = _mm256_set1_pd(inStart);
+	__m256d b = _mm256_set1_pd(outStart);
+	__m256d c0 = _mm256_set1_pd(C0);
+	__m256d halfAlpha = _mm256_set1_pd(0.5*alpha);
+	u32 i = 0;
+	for(; i+4 <= count; i+=4)
+	{
+		__m256d t = _mm256_sub_pd(_mm256_loadu_pd(in + i), a);
+		__m256d slope = _mm256_fmadd_pd(halfAlpha, t, c0);
+		_mm256_storeu_pd(out + i, _mm256_fmadd_pd(t, slope, b));
+	}
+	sched_curve_kernel_quadratic_scalar(in + i, out + i, count - i, inStart, outStart, C0, alpha);
+}
+
+__attribute__((target("avx2,fma")))
+void sched_curve_kernel_sqrt_avx2(const f64* in, f64* out, u32 count, f64 inStart, f64 outStart, f64 C0, f64 alpha)
+{
+	__m256d a = _mm256_set1_pd(inStart);
+	__m256d b = _mm256_set1_pd(outStart);
+	__m256d c0 = _mm256_set1_pd(C0);
+	__m256d c02 = _mm256_set1_pd(C0*C0);
+	__m256d twoAlpha = _mm256_set1_pd(2*alpha);
+	__m256d invAlpha = _mm256_set1_pd(1./alpha);
+	u32 i = 0;
+	for(; i+4 <= count; i+=4)
+	{
+		__m256d p = _mm256_sub_pd(_mm256_loadu_pd(in + i), a);
+		__m256d root = _mm256_sqrt_pd(_mm256_fmadd_pd(twoAlpha, p, c02));
+		_mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_sub_pd(root, c0), invAlpha, b));
+	}
+	sched_curve_kernel_sqrt_scalar(in + i, out + i, count - i, inStart, outStart, C0, alpha);
+}
+
+#endif // __x86_64__
+
+typedef struct sched_curve_kernels
+{
+	sched_curve_kernel_affine affine;
+	sched_curve_kernel_linear quadratic;
+	sched_curve_kernel_linear squareRoot;
+
+} sched_curve_kernels;
+
+sched_curve_kernels sched_curve_select_kernels()
+{
+	//NOTE(martin): select the kernels depending on the cpu features
+	sched_curve_kernels kernels = {.affine = sched_curve_kernel_affine_scalar,
+	                               .quadratic = sched_curve_kernel_quadratic_scalar,
+	                               .squareRoot = sched_curve_kernel_sqrt_scalar};
+
+	#if defined(__x86_64__)
+		if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		{
+			kernels.affine = sched_curve_kernel_affine_avx2;
+			kernels.quadratic = sched_curve_kernel_quadratic_avx2;
+			kernels.squareRoot = sched_curve_kernel_sqrt_avx2;
+		}
+	#endif
+	return(kernels);
+}
+
+sched_curve_kernels* sched_curve_get_kernels()
+{
+	//NOTE(martin): the kernels are selected once, on first use. The initialization of a static local is thread-safe,
+	//              so queries from other threads never see a partially initialized table.
+	static sched_curve_kernels kernels = sched_curve_select_kernels();
+	return(&kernels);
+}
+
+//------------------------------------------------------------------------------------------------------
+// batch conversions
+//------------------------------------------------------------------------------------------------------
+
+void sched_curve_convert_run(sched_curve* curve, bool fromTime, u32 eltIndex, const f64* in, f64* out, u32 count)
+{
+	//NOTE(martin): convert a run of sorted inputs that all fall in the same element
+	sched_curve_kernels* kernels = sched_curve_get_kernels();
+
+	f64 inStart = fromTime ? curve->eltStartTimes[eltIndex] : curve->eltStartPositions[eltIndex];
+	f64 outStart = fromTime ? curve->eltStartPositions[eltIndex] : curve->eltStartTimes[eltIndex];
+
+	if(eltIndex >= curve->eltCount)
+	{
+		//NOTE(martin): extend end tempo after the end of the curve.
+		f64 endTempo = curve->elements[curve->eltCount-1].endValue;
+		kernels->affine(in, out, count, inStart, outStart, fromTime ? endTempo : 1./endTempo);
+		return;
+	}
+
+	sched_curve_elt* elt = &(curve->elements[eltIndex]);
+	sched_curve_chebyshev* fit = fromTime ? &elt->posFromTime : &elt->timeFromPos;
+	f64 C0 = elt->startValue;
+
+	if(fit->pieceCount)
+	{
+		for(u32 i=0; i<count; i++)
+		{
+			out[i] = outStart + sched_curve_chebyshev_eval(curve, fit, in[i] - inStart);
+		}
+	}
+	else if(elt->type == SCHED_CURVE_CONST || elt->type == SCHED_CURVE_STEP)
+	{
+		kernels->affine(in, out, count, inStart, outStart, fromTime ? C0 : 1./C0);
+	}
+	else if(elt->type == SCHED_CURVE_LINEAR
+	       && curve->axes == SCHED_CURVE_TIME_TEMPO
+	       && fabs(elt->endValue - elt->startValue)/elt->length > 1e-9)
+	{
+		f64 alpha = (elt->endValue - elt->startValue)/elt->length;
+		if(fromTime)
+		{
+			kernels->quadratic(in, out, count, inStart, outStart, C0, alpha);
+		}
+		else
+		{
+			kernels->squareRoot(in, out, count, inStart, outStart, C0, alpha);
+		}
+	}
+	else if(elt->type == SCHED_CURVE_BEZIER
+	       && elt->quadrature == SCHED_CURVE_QUADRATURE_GAUSS
+	       && fromTime == (curve->axes == SCHED_CURVE_POS_TEMPO))
+	{
+		//NOTE(martin): the inverse map of bezier elements restarts each inversion from the previous solution,
+		//              as curve cursors do.
+		bezier_integral integral = {.coeffs = &elt->coeffs,
+		                            .axes = curve->axes,
+		                            .panelCount = elt->quadraturePanels,
+		                            .epsilon = elt->tolerance*SCHED_CURVE_SOLVER_TOLERANCE_RATIO};
+		f64 param = 0;
+		f64 paramValue = 0;
+		for(u32 i=0; i<count; i++)
+		{
+			param = bezier_integral_invert_from(&integral, elt->transformedLength, in[i] - inStart, param, paramValue, &paramValue);
+			out[i] = outStart + bezier_sample_x(&elt->coeffs, param);
+		}
+	}
+	else
+	{
+		for(u32 i=0; i<count; i++)
+		{
+			f64 x = in[i] - inStart;
+			out[i] = outStart + (fromTime ? sched_curve_elt_pos_from_time(curve->axes, elt, x)
+			                              : sched_curve_elt_time_from_pos(curve->axes, elt, x));
+		}
+	}
+}
+
+void sched_curve_convert_batch(sched_curve* curve, bool fromTime, const f64* in, f64* out, u32 count)
+{
+	//NOTE(martin): split the inputs in runs of sorted values that fall in the same element. For sorted inputs,
+	//              we walk the elements only once. Otherwise each run starts with a binary search.
+	const f64* ends = (fromTime ? curve->eltStartTimes : curve->eltStartPositions) + 1;
+	u32 eltIndex = 0;
+
+	if(curve->integratedCount < curve->eltCount && count)
+	{
+		f64 maxInput = in[0];
+		for(u32 i=1; i<count; i++)
+		{
+			maxInput = maximum(maxInput, in[i]);
+		}
+		sched_curve_require(curve, ends - 1, maxInput);
+	}
+	u32 eltCount = sched_curve_published_count(curve);
 
-			case SCHED_CURVE_TIME_TEMPO:
+	u32 i = 0;
+	while(i < count)
+	{
+		if(i == 0 || in[i] < in[i-1])
+		{
+			eltIndex = sched_curve_search(ends, eltCount, in[i]);
+		}
+		else
+		{
+			while(eltIndex < eltCount && ends[eltIndex] < in[i])
 			{
-				f64 update = sched_time_tempo_integrate_over_pos(elt, p);
-				*outTime = eltStartTime + update;
-			} break;
+				eltIndex++;
+			}
 		}
-		return(0);
+
+		u32 runEnd = i+1;
+		while(runEnd < count
+		     && in[runEnd] >= in[runEnd-1]
+		     && (eltIndex == eltCount || in[runEnd] <= ends[eltIndex]))
+		{
+			runEnd++;
+		}
+		sched_curve_convert_run(curve, fromTime, eltIndex, in + i, out + i, runEnd - i);
+		i = runEnd;
+	}
+}
+
+void sched_curve_get_positions_from_times(sched_curve* curve, const f64* times, f64* outPositions, u32 count)
+{
+	sched_curve_convert_batch(curve, true, times, outPositions, count);
+}
+
+void sched_curve_get_times_from_positions(sched_curve* curve, const f64* positions, f64* outTimes, u32 count)
+{
+	sched_curve_convert_batch(curve, false, positions, outTimes, count);
+}
+
+//------------------------------------------------------------------------------------------------------
+// curve cursors
+//------------------------------------------------------------------------------------------------------
+
+void sched_curve_cursor_init(sched_curve_cursor* cursor)
+{
+	memset(cursor, 0, sizeof(sched_curve_cursor));
+}
+
+int sched_curve_cursor_get_position_from_time(sched_curve* curve, sched_curve_cursor* cursor, f64 time, f64* outPos)
+{
+	if(time < cursor->time)
+	{
+		//NOTE(martin): backward jump, restart from the beginning of the curve
+		sched_curve_cursor_init(cursor);
+	}
+
+	//NOTE(martin): find the element containing time if we left the current one. Monotonic queries usually move to
+	//              the next element, otherwise (eg. after the cursor was reset) we do a binary search.
+	sched_curve_require(curve, curve->eltStartTimes, time);
+	u32 eltCount = sched_curve_published_count(curve);
+	if(cursor->eltIndex < eltCount && curve->eltStartTimes[cursor->eltIndex+1] < time)
+	{
+		u32 next = cursor->eltIndex + 1;
+		if(next < eltCount && curve->eltStartTimes[next+1] < time)
+		{
+			next = sched_curve_search(curve->eltStartTimes + 1, eltCount, time);
+		}
+		cursor->eltIndex = next;
+		cursor->eltStartTime = curve->eltStartTimes[next];
+		cursor->eltStartPos = curve->eltStartPositions[next];
+		cursor->param = 0;
+		cursor->paramValue = 0;
 	}
+	cursor->time = time;
+
+	if(cursor->eltIndex >= curve->eltCount)
+	{
+		//NOTE(martin): extend end tempo after the end of the curve.
+		sched_curve_elt* endElt = &(curve->elements[(curve->eltCount)-1]);
+		*outPos = cursor->eltStartPos + (time - cursor->eltStartTime)*endElt->endValue;
+		return(1);
+	}
+
+	sched_curve_elt* elt = &(curve->elements[cursor->eltIndex]);
+	f64 t = time - cursor->eltStartTime;
+
+	if(elt->posFromTime.pieceCount)
+	{
+		*outPos = cursor->eltStartPos + sched_curve_chebyshev_eval(curve, &elt->posFromTime, t);
+	}
+	else if(curve->axes == SCHED_CURVE_POS_TEMPO
+	       && elt->type == SCHED_CURVE_BEZIER
+	       && elt->quadrature == SCHED_CURVE_QUADRATURE_GAUSS)
+	{
+		//NOTE(martin): restart the inversion from the parameter and partial integral of the previous query, so that
+		//              we only integrate over the advance.
+		bezier_integral integral = {.coeffs = &elt->coeffs,
+		                            .axes = SCHED_CURVE_POS_TEMPO,
+		                            .panelCount = elt->quadraturePanels,
+		                            .epsilon = elt->tolerance*SCHED_CURVE_SOLVER_TOLERANCE_RATIO};
+
+		cursor->param = bezier_integral_invert_from(&integral,
+		                                            elt->transformedLength,
+		                                            t,
+		                                            cursor->param,
+		                                            cursor->paramValue,
+		                                            &cursor->paramValue);
+
+		*outPos = cursor->eltStartPos + bezier_sample_x(&elt->coeffs, cursor->param);
+	}
+	else
+	{
+		*outPos = cursor->eltStartPos + sched_curve_elt_pos_from_time(curve->axes, elt, t);
+	}
+	return(0);
 }
 
 #undef LOG_SUBSYSTEM
@@ -14,9 +14,23 @@
 typedef enum { SCHED_CURVE_POS_TEMPO = 0,
                SCHED_CURVE_TIME_TEMPO } sched_curve_axes;
 
+//NOTE(martin): tempo shapes along the main axis x of the curve, from startValue to endValue over length:
+//              - const:       startValue
+//              - linear:      linear interpolation between startValue and endValue
+//              - bezier:      cubic Bezier from startValue to endValue, with control points p1 and p2
+//              - sampled:     linear interpolation of a sampled tempo track (see below)
+//              - exponential: startValue * (endValue/startValue)^(x/length), ie. a constant tempo ratio per unit
+//              - power:       startValue * (1 + beta*x)^exponent, with beta such that the tempo reaches endValue.
+//                             An exponent of 1 is a linear ramp, larger exponents bend it towards the end.
+//              - step:        holds startValue over the element, then steps to endValue. endValue is only used
+//                             when the step is the last element, for the tempo after the end of the curve.
 typedef enum { SCHED_CURVE_CONST = 0,
                SCHED_CURVE_LINEAR,
-	       SCHED_CURVE_BEZIER } sched_curve_type;
+	       SCHED_CURVE_BEZIER,
+	       SCHED_CURVE_SAMPLED,
+	       SCHED_CURVE_EXPONENTIAL,
+	       SCHED_CURVE_POWER,
+	       SCHED_CURVE_STEP } sched_curve_type;
 
 typedef struct sched_curve_descriptor_elt
 {
@@ -31,21 +45,96 @@ typedef struct sched_curve_descriptor_elt
 	f64 p2x;
 	f64 p2y;
 
+	//NOTE(martin): exponent of power elements. Must not be zero.
+	f64 exponent;
+
+	//NOTE(martin): sampled tempo track, linearly interpolated between samples. The samples are copied when the curve is
+	//              created. If sampleOffsets is null, the samples are uniformly spaced over length. Otherwise it gives
+	//              the location of each sample from the start of the element, starting at 0 and strictly increasing,
+	//              and the length of the element is the last offset. startValue and endValue are ignored.
+	u32 sampleCount;
+	const f32* samples;
+	const f64* sampleOffsets;
+
 } sched_curve_descriptor_elt;
 
+//NOTE(martin): integration method for Bezier elements. The default uses Gauss-Legendre quadrature for integrals that
+//              don't have a closed form, and Newton iteration on these integrals for the inverse queries. The adaptive
+//              Runge-Kutta integrators are kept as a reference.
+typedef enum { SCHED_CURVE_QUADRATURE_GAUSS = 0,
+               SCHED_CURVE_QUADRATURE_RKCK } sched_curve_quadrature;
+
+//NOTE(martin): accuracy profile of a curve, which selects the default tolerance of its solvers. The precise profile
+//              targets nanosecond accuracy, and the fast profile targets a tenth of a millisecond, which is enough for
+//              eg. lighting cues and makes Bezier queries several times cheaper.
+typedef enum { SCHED_CURVE_PROFILE_PRECISE = 0,
+               SCHED_CURVE_PROFILE_FAST } sched_curve_profile;
+
 typedef struct sched_curve_descriptor
 {
 	sched_curve_axes axes;
 	u32 eltCount;
 	sched_curve_descriptor_elt* elements;
 
+	sched_curve_quadrature quadrature;
+
+	//NOTE(martin): maximum absolute error of time and position queries on Bezier elements, in seconds or beats. 0
+	//              selects the default tolerance of the profile (1e-9 for the precise profile, and 1e-4 for the fast
+	//              profile). The quadrature, inversion and Runge-Kutta solvers derive their own, tighter tolerances from it.
+	sched_curve_profile profile;
+	f64 tolerance;
+
+	//NOTE(martin): if compile is true, the time/position maps of Bezier elements are approximated by piecewise
+	//              Chebyshev polynomials when the curve is created, so that queries don't need to integrate.
+	//              compileTolerance is the maximum absolute error, in seconds or beats (0 selects the curve's tolerance).
+	//              Elements that can't be fitted within the tolerance keep using the exact integration.
+	bool compile;
+	f64 compileTolerance;
+
+	//NOTE(martin): if lazy is true, elements are only integrated when a query first reaches them, so that creating a
+	//              huge curve doesn't have to integrate it all. Elements are still validated and set up (eg. Bezier
+	//              coefficients, sample tables, breakpoints on the main axis) at creation, so creation stays linear in
+	//              the number of elements, with a smaller constant. Lazy curves can't be compiled.
+	bool lazy;
+
 } sched_curve_descriptor;
 
+typedef struct sched_curve_compile_report
+{
+	u32 compiledEltCount;  // number of elements whose maps are both approximated
+	u32 fallbackEltCount;  // number of Bezier elements for which at least one map falls back to exact integration
+	u32 coeffCount;        // total number of Chebyshev coefficients
+	f64 maxPosError;       // error bound of the position from time approximations, estimated at creation
+	f64 maxTimeError;      // error bound of the time from position approximations, estimated at creation
+
+} sched_curve_compile_report;
+
 struct sched_curve;
 
+//NOTE(martin): curves are immutable and reference counted, so that a single curve can be shared by several tasks.
+//              sched_curve_create() returns a curve with one reference, owned by the caller. Tasks take their own
+//              reference when a curve is attached to them. sched_curve_destroy() is the same as sched_curve_release().
 sched_curve* sched_curve_create(sched_curve_descriptor* descriptor);
+sched_curve* sched_curve_retain(sched_curve* curve);
+void sched_curve_release(sched_curve* curve);
 void sched_curve_destroy(sched_curve* curve);
 
+void sched_curve_get_compile_report(sched_curve* curve, sched_curve_compile_report* report);
+
+//NOTE(martin): sched_curve_prewarm() integrates the elements of a lazy curve up to the given time, so that later
+//              queries don't have to. It is thread-safe, and returns the time up to which the curve is integrated.
+f64 sched_curve_prewarm(sched_curve* curve, f64 time);
+bool sched_curve_is_integrated(sched_curve* curve);
+
+//NOTE(martin): curve edits return a new curve with one reference, and leave the source curve untouched, so that the
+//              result can be swapped on tasks that are using the source curve. Only the new elements are integrated,
+//              the other ones are copied and shifted. They return 0 if the edit is invalid.
+//
+//              sched_curve_replace_range() replaces count elements starting at first with eltCount new elements.
+sched_curve* sched_curve_replace_range(sched_curve* curve, u32 first, u32 count, u32 eltCount, sched_curve_descriptor_elt* elements);
+sched_curve* sched_curve_append(sched_curve* curve, u32 eltCount, sched_curve_descriptor_elt* elements);
+sched_curve* sched_curve_truncate(sched_curve* curve, u32 eltCount);
+
 //NOTE(martin): curve pos/time conversion functions return values are:
 //		-1 if the abscissa was before the beginning of the curve,
 //              +1 if the abscissa was after the end of the curve
@@ -54,4 +143,27 @@ void sched_curve_destroy(sched_curve* curve);
 int sched_curve_get_position_from_time(sched_curve* curve, f64 time, f64* outPos);
 int sched_curve_get_time_from_position(sched_curve* curve, f64 pos, f64* outTime);
 
+//NOTE(martin): batch versions of the above. Inputs can be in any order, but sorted inputs are faster since they
+//              are converted in runs that walk the curve elements only once.
+void sched_curve_get_positions_from_times(sched_curve* curve, const f64* times, f64* outPositions, u32 count);
+void sched_curve_get_times_from_positions(sched_curve* curve, const f64* positions, f64* outTimes, u32 count);
+
+//NOTE(martin): a cursor remembers where the last query landed in a curve, so that monotonic queries only walk the
+//              elements and integrate over the advance since the previous query. A query before the previous one
+//              restarts from the beginning of the curve. The fields are private, and a cursor must be reinitialized
+//              when used with another curve.
+typedef struct sched_curve_cursor
+{
+	u32 eltIndex;
+	f64 eltStartTime;
+	f64 eltStartPos;
+	f64 time;       // time of the last query
+	f64 param;      // bezier parameter of the last query in the current element
+	f64 paramValue; // integral from the start of the element to param
+
+} sched_curve_cursor;
+
+void sched_curve_cursor_init(sched_curve_cursor* cursor);
+int sched_curve_cursor_get_position_from_time(sched_curve* curve, sched_curve_cursor* cursor, f64 time, f64* outPos);
+
 #endif //__SCHED_CURVES_H_
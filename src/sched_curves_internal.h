@@ -9,6 +9,7 @@
 #ifndef __SCHED_CURVES_INTERNAL_H_
 #define __SCHED_CURVES_INTERNAL_H_
 
+#include"platform_thread.h"
 #include"sched_curves.h"
 
 //------------------------------------------------------------------------------------------------------
@@ -19,8 +20,53 @@ typedef struct bezier_coeffs
 {
 	f64 cx[4];
 	f64 cy[4];
+
+	//NOTE(martin): power basis coefficients of the integral of y(s)*x'(s) from 0 to s. y*x' is a degree 5 polynomial,
+	//              so its integral is an exact degree 6 polynomial. This gives the position of time-tempo elements.
+	f64 yDxIntegral[7];
+
+	//NOTE(martin): closed-form solve of x(s) = x, selected at creation depending on the degree of x(s) and its
+	//              monotonicity on [0, 1]. For cubics, xSolve holds 1/cx3, the shift cx2/(3*cx3), and the
+	//              coefficients p and q0 of the depressed cubic t^3 + p*t + q0 - x/cx3 = 0, with s = t - shift.
+	u32 xSolveKind;
+	f64 xSolve[4];
+
+	//NOTE(martin): maximum residual of the iterative solve of x(s) = x, used when there's no closed-form solve.
+	f64 xTolerance;
 } bezier_coeffs;
 
+//NOTE(martin): piecewise Chebyshev approximation of a map over an element, with uniform pieces over [0, domain].
+//              pieceCount is 0 if the map isn't approximated.
+const u32 SCHED_CURVE_CHEBYSHEV_ORDER = 16;
+const u32 SCHED_CURVE_CHEBYSHEV_MAX_PIECES = 64;
+
+typedef struct sched_curve_chebyshev
+{
+	u32 pieceCount;
+	u32 offset;     // index of the first coefficient in the curve's coefficients buffer
+	f64 domain;
+	f64 pieceScale; // pieceCount/domain
+	f64 error;      // error bound estimated when fitting
+
+} sched_curve_chebyshev;
+
+//NOTE(martin): tables of a sampled element. The tempo is linearly interpolated between the samples, along the main
+//              axis of the curve. Samples are uniformly spaced by step, or placed at offsets from the start of the
+//              element. integral holds the transformed value (ie. time for position-tempo curves and position for
+//              time-tempo curves) at each sample. Tables are immutable and reference counted, so that curve edits
+//              can share them.
+typedef struct sched_curve_samples
+{
+	_Atomic(u32) refCount;
+	u32 count;
+	f64 step;       // 0 for non-uniform samples
+	f64 invStep;
+	f32* values;
+	f64* offsets;   // null for uniform samples
+	f64* integral;
+
+} sched_curve_samples;
+
 typedef struct sched_curve_elt
 {
 	sched_curve_type type;
@@ -40,15 +86,60 @@ typedef struct sched_curve_elt
 
 	//TODO precomputed slope, curve power basis coefficients, etc...
 	bezier_coeffs coeffs;
+	sched_curve_samples* samples;
+
+	//NOTE(martin): exponential elements: tempo = startValue * exp(rate*x)
+	//              power elements:       tempo = startValue * (1 + rate*x)^exponent
+	f64 rate;
+	f64 exponent;
+
+	//NOTE(martin): integration method and tolerance of bezier elements, and number of Gauss-Legendre panels over
+	//              [0, 1] needed to reach that tolerance for position-tempo curves.
+	sched_curve_quadrature quadrature;
+	f64 tolerance;
+	u32 quadraturePanels;
+
+	//NOTE(martin): compiled approximations of the maps from the element's start time/position
+	sched_curve_chebyshev posFromTime;
+	sched_curve_chebyshev timeFromPos;
 
 } sched_scaling_elt;
 
 typedef struct sched_curve
 {
+	//NOTE(martin): curves are immutable once created (apart from the lazy integration of their elements), and can be
+	//              shared between tasks (and threads). They are freed when their reference count drops to zero.
+	_Atomic(u32) refCount;
+
 	sched_curve_axes axes;
+	sched_curve_quadrature quadrature;
+	f64 tolerance;
+	bool compile;
+	f64 compileTolerance;
+
 	u32 eltCount;
 	sched_curve_elt* elements;
 
+	//NOTE(martin): start time and start position of each element, followed by the end of the curve (ie. eltCount+1
+	//              entries). These are kept apart from the elements so that searches only touch these arrays.
+	f64* eltStartTimes;
+	f64* eltStartPositions;
+
+	//NOTE(martin): elements before integratedCount are integrated. For lazy curves, the other ones are integrated
+	//              when a query first reaches them, under integrationMutex. Until then, their entries in the array of
+	//              the transformed axis (ie. eltStartTimes for position-tempo curves) are +infinity, and queries
+	//              only search the entries published by integratedCount.
+	bool lazy;
+	_Atomic(u32) integratedCount;
+	ticket_spin_mutex integrationMutex;
+
+	//NOTE(martin): the coefficients are allocated separately while compiling, and then moved at the end of the
+	//              curve block when the curve is created.
+	u32 chebyshevCoeffCount;
+	f64* chebyshevCoeffs;
+	bool chebyshevCoeffsInline;
+	sched_curve_compile_report compileReport;
+
 } sched_curve;
 
 
@@ -53,6 +53,7 @@ typedef enum { SCHED_STATE_UNSYNC,
 const u64 SCHED_FIBER_STACK_SIZE = 1<<20;
 
 typedef struct sched_task_info sched_task_info;
+typedef struct sched_action_info sched_action_info;
 
 typedef enum { SCHED_STATUS_ACTIVE,
                SCHED_STATUS_SUSPENDED,
@@ -60,8 +61,23 @@ typedef enum { SCHED_STATUS_ACTIVE,
                SCHED_STATUS_IDLE,
 	       SCHED_STATUS_COMPLETED } sched_object_status;
 
+typedef enum { SCHED_EVENT_FIBER,
+               SCHED_EVENT_TIMER } sched_event_kind;
+
+typedef struct sched_event_info
+{
+	//NOTE(martin): common header of the objects that can be put in a task's event queue
+	list_info listElt;
+	sched_event_kind kind;
+	f64 logicalLoc;
+	u64 ticket;
+
+} sched_event_info;
+
 typedef struct sched_fiber_info
 {
+	sched_event_info event;
+
 	list_info waiting;
 	list_info waitingElt;
 	sched_object_signal waitingFor;
@@ -70,12 +86,9 @@ typedef struct sched_fiber_info
 	sched_object_status status;
 	i64 exitCode;
 
-	list_info listElt;
 	sched_task_info* task;
 	i32 openHandles;
-
-	f64 logicalLoc;
-	u64 ticket;
+	sched_fiber selfHandle; //NOTE: borrowed handle returned by sched_fiber_self(), allocated lazily
 
 	list_info jobQueueElt;
 
@@ -94,6 +107,7 @@ typedef struct sched_task_info
 	list_info children;
 
 	i32 openHandles;
+	sched_task selfHandle; //NOTE: borrowed handle returned by sched_task_self(), allocated lazily
 
 	sched_object_status status;
 	i64 exitCode;
@@ -102,6 +116,8 @@ typedef struct sched_task_info
 	//sync / scale description
 	sched_timescale_descriptor descriptor;
 	sched_curve* tempoCurve;
+	sched_curve_cursor tempoCursor;
+	f64 tempoPrewarmTime; //NOTE: time up to which a background prewarm of a lazy tempo curve was requested
 
 	//runtime sync values
 	f64 srcOffset;  //NOTE: offset of the start of the timescale, in the time source reference
@@ -110,32 +126,90 @@ typedef struct sched_task_info
 	f64 logicalLoc; //NOTE: location of the current event or = selfLoc
 
 	sched_fiber_info* mainFiber;
+	u32 fiberCount;
 
-	//NOTE: scheduled fibers
-	list_info fibers;
+	//NOTE: scheduled events (fibers and timers), and suspended fibers
+	list_info events;
 	list_info suspended;
 
+	//NOTE: pending actions, tracked only if they must be cancelled along with the task
+	bool cancelActions;
+	list_info pendingActions;
+
 } sched_task_info;
 
+typedef struct sched_timer_info
+{
+	sched_event_info event;
+
+	list_info waiting;
+	sched_object_status status;
+	i32 openHandles;
+
+	sched_task_info* task;
+	sched_steps period;
+	sched_timer_callback callback;
+	void* userPointer;
+
+} sched_timer_info;
+
 //----------------------------------------------------------------------------------
 // Handles structures
 //----------------------------------------------------------------------------------
 typedef enum { SCHED_HANDLE_INVALID = 0,
                SCHED_HANDLE_FREE,
                SCHED_HANDLE_FIBER,
-	       SCHED_HANDLE_TASK } sched_handle_slot_kind;
+	       SCHED_HANDLE_TASK,
+	       SCHED_HANDLE_TIMER,
+	       SCHED_HANDLE_ACTION } sched_handle_slot_kind;
 
 typedef struct sched_handle_slot
 {
-	u32 generation;
-	sched_handle_slot_kind kind;
+	//NOTE: generation, kind, object and borrowed are read by lock-free lookups, see sched_handle_slot_find_generic()
+	_Atomic(u32) generation;
+	_Atomic(sched_handle_slot_kind) kind;
+	_Atomic(void*) object;
+	_Atomic(bool) borrowed; //NOTE: borrowed handles don't own a reference to their object and can't be released
+
+	u32 index;
+	list_info freeListElt;
+} sched_handle_slot;
+
+//NOTE(martin): copy of a slot's payload, taken by sched_handle_slot_find_generic() while the slot's generation matched
+typedef struct sched_handle_lookup
+{
+	sched_handle_slot* slot;
+	bool borrowed;
 	union
 	{
-		list_info freeListElt;
+		void* object;
 		sched_fiber_info* fiber;
 		sched_task_info* task;
+		sched_timer_info* timer;
+		sched_action_info* action;
 	};
-} sched_handle_slot;
+} sched_handle_lookup;
+
+/*NOTE(martin): handle table
+
+	Handle slots are allocated in fixed-size segments, which are never moved or freed before sched_end(). The table can thus
+	grow without invalidating slot pointers, and the slot of a handle is found in O(1) from its index.
+
+	Slots are only allocated and recycled by the scheduler thread. Other threads can look up handles without taking a lock:
+	segments and nextSlot are published atomically once initialized, and the generation of a slot is incremented before
+	its payload is modified when it is recycled. Lookups copy the payload between two reads of the generation, like a
+	sequence lock, so that they never return a mix of an old and a new payload, and stale handles are detected.
+*/
+const u32 SCHED_HANDLE_SEGMENT_SIZE = 1024;
+const u32 SCHED_HANDLE_MAX_SEGMENTS = 4096;
+
+typedef struct sched_handle_table
+{
+	_Atomic(sched_handle_slot*) segments[SCHED_HANDLE_MAX_SEGMENTS];
+	_Atomic(u32) nextSlot;
+	list_info freeList;
+
+} sched_handle_table;
 
 //----------------------------------------------------------------------------------
 // Background Jobs queue
@@ -143,6 +217,26 @@ typedef struct sched_handle_slot
 
 const u32 SCHED_BACKGROUND_QUEUE_THREAD_COUNT = 8;
 
+//NOTE(martin): requests to integrate lazy tempo curves ahead of the tasks that use them. These are best effort:
+//              if the queue is full, queries will integrate the elements on the scheduler thread.
+const u32 SCHED_CURVE_PREWARM_QUEUE_SIZE = 16;
+const f64 SCHED_CURVE_PREWARM_WINDOW = 4;
+
+typedef struct sched_curve_prewarm_request
+{
+	sched_curve* curve;
+	f64 time;
+} sched_curve_prewarm_request;
+
+//NOTE(martin): busy is set while the worker runs a background fiber, and is protected by the queue mutex
+typedef struct sched_background_worker
+{
+	struct sched_info* sched;
+	platform_thread* thread;
+	bool busy;
+
+} sched_background_worker;
+
 typedef struct sched_job_queue
 {
 	_Atomic(bool) running;
@@ -150,7 +244,10 @@ typedef struct sched_job_queue
 	platform_condition* condition;
 	list_info list;
 
-	platform_thread* threads[SCHED_BACKGROUND_QUEUE_THREAD_COUNT];
+	u32 prewarmCount;
+	sched_curve_prewarm_request prewarmRequests[SCHED_CURVE_PREWARM_QUEUE_SIZE];
+
+	sched_background_worker workers[SCHED_BACKGROUND_QUEUE_THREAD_COUNT];
 
 } sched_job_queue;
 
@@ -158,7 +255,19 @@ typedef struct sched_job_queue
 // Scheduler actions
 //----------------------------------------------------------------------------------
 
-const u32 SCHED_ACTION_INFO_SBO_SIZE = 128;
+//NOTE(martin): action payloads are copied into size-class pools owned by the scheduler, so that action records stay
+//              compact and emitting an action doesn't call malloc on the scheduler's hot path. Classes are powers of
+//              two from 16 bytes to 64KB, and bigger payloads are rejected. The pools of all classes are reserved at
+//              init, which only costs address space.
+
+const u32 SCHED_ACTION_PAYLOAD_MIN_SIZE_LOG2 = 4,
+          SCHED_ACTION_PAYLOAD_CLASS_COUNT = 13,
+          SCHED_ACTION_PAYLOAD_MAX_SIZE = 1<<(SCHED_ACTION_PAYLOAD_MIN_SIZE_LOG2 + SCHED_ACTION_PAYLOAD_CLASS_COUNT - 1);
+
+const u64 SCHED_ACTION_PAYLOAD_POOL_MIN_RESERVE = 16<<20;
+
+//NOTE(martin): payloadClass values below SCHED_ACTION_PAYLOAD_CLASS_COUNT are size class indices
+const u32 SCHED_ACTION_PAYLOAD_NONE = SCHED_ACTION_PAYLOAD_CLASS_COUNT; // no-copy action, userPointer is owned by the user
 
 typedef struct sched_action_info
 {
@@ -166,35 +275,112 @@ typedef struct sched_action_info
 	f64 delay;
 	sched_action_callback callback;
 	void* userPointer;
-	bool allocatedData;
-	char sbo[SCHED_ACTION_INFO_SBO_SIZE];
+	u32 payloadClass;
+
+	u64 handle;        //NOTE: borrowed handle returned by sched_action_create(), or 0
+	list_info taskElt; //NOTE: element in the emitting task's pendingActions list, if it cancels its actions
+
+	bool staged;       //NOTE: staged for the output ring, see sched_action_ring_flush()
+	u32 dataSize;      //NOTE: payload size and target time of staged actions
+	f64 time;
 
 } sched_action_info;
 
+//----------------------------------------------------------------------------------
+// Action output ring
+//----------------------------------------------------------------------------------
+
+//NOTE(martin): single producer (scheduler thread), single consumer (audio thread) byte ring. Records are variable size,
+//              8 bytes aligned, and never straddle the end of the buffer: when a record doesn't fit before the end,
+//              we write a padding record and wrap around. Read and write indices grow monotonically and are masked
+//              on access, so the capacity must be a power of two.
+//              Records are not necessarily in order of their target time (eg. timestamped posts can target an earlier
+//              time than actions emitted by fibers). The consumer skips the records that fall after its block and marks
+//              the ones it drains by clearing their callback, and the read index only moves past drained records.
+
+const u32 SCHED_ACTION_RING_DEFAULT_SIZE = 64<<10;
+
+typedef struct sched_action_ring_header
+{
+	u32 recordSize; // total size of the record, including header and payload
+	u32 dataSize;   // size of the inline payload, or 0 for no-copy records
+	f64 time;
+	sched_action_callback callback; // null for padding records
+	void* userPointer;              // for no-copy records
+
+} sched_action_ring_header;
+
+typedef struct sched_action_ring
+{
+	_Atomic(u64) writeIndex;
+	_Atomic(u64) readIndex;
+	u64 capacity;
+	char* buffer;
+
+} sched_action_ring;
+
 //----------------------------------------------------------------------------------
 // Scheduler structure
 //----------------------------------------------------------------------------------
 const f64 SCHEDULER_FUSION_THRESHOLD = 100e-9;
 
 typedef enum { SCHED_MESSAGE_FOREGROUND,
-               SCHED_MESSAGE_WAKEUP } sched_message_kind;
+               SCHED_MESSAGE_WAKEUP,
+	       SCHED_MESSAGE_RENDER_DEADLINE,
+	       SCHED_MESSAGE_ACTION,
+	       SCHED_MESSAGE_FIBER_CREATE,
+	       SCHED_MESSAGE_TASK_SET_SCALING,
+	       SCHED_MESSAGE_TASK_SET_CURVE } sched_message_kind;
+
+const u32 SCHED_MESSAGE_PAYLOAD_SIZE = 64;
 
 typedef struct sched_message
 {
 	list_info listElt;
 	sched_message_kind kind;
+	f64 timestamp; // for commands posted by other threads. 0 means "as soon as possible"
 
 	union
 	{
 		sched_fiber_info* fiber; //SCHED_MESSAGE_FOREGROUND
 		sched_fiber fiberHandle; //SCHED_MESSAGE_WAKEUP
 
-		//...
+		struct
+		{
+			sched_action_callback callback;
+			u32 size;
+			char data[SCHED_MESSAGE_PAYLOAD_SIZE];
+		} action; //SCHED_MESSAGE_ACTION
+
+		struct
+		{
+			sched_task task;
+			sched_fiber_proc proc;
+			void* userPointer;
+		} fiberCreate; //SCHED_MESSAGE_FIBER_CREATE
+
+		struct
+		{
+			sched_task task;
+			f64 scaling;
+		} taskScaling; //SCHED_MESSAGE_TASK_SET_SCALING
+
+		struct
+		{
+			sched_task task;
+			sched_curve* curve;
+		} taskCurve; //SCHED_MESSAGE_TASK_SET_CURVE
 	};
 
 } sched_message;
 
-const u32 SCHED_MAX_HANDLE_SLOTS = 1024;
+//NOTE(martin): sort keys for batch submissions
+typedef struct sched_batch_entry
+{
+	f64 key;
+	u32 index;
+
+} sched_batch_entry;
 
 typedef struct sched_info
 {
@@ -203,10 +389,10 @@ typedef struct sched_info
 	mem_pool taskPool;
 	mem_pool stackPool;
 	mem_pool actionPool;
+	mem_pool actionPayloadPools[SCHED_ACTION_PAYLOAD_CLASS_COUNT];
+	mem_pool timerPool;
 
-	sched_handle_slot handleSlots[SCHED_MAX_HANDLE_SLOTS];
-	u32 nextHandleSlot;
-	list_info handleFreeList;
+	sched_handle_table handles;
 
 	platform_condition* msgCondition;
 	platform_mutex* msgConditionMutex;
@@ -221,6 +407,10 @@ typedef struct sched_info
 	list_info runningTasks;
 	list_info suspendedTasks;
 	sched_fiber_info* currentFiber;
+	sched_timer_info* currentTimer;
+
+	//NOTE(martin): set by sched_init(), and cleared by sched_end()
+	bool initialized;
 
 	f64 lastTimeUpdate;
 	f64 timeToSleepResidue;
@@ -230,14 +420,32 @@ typedef struct sched_info
 	f64 lookAhead;
 	f64 lookAheadWindow;
 
+	//NOTE(martin): offline rendering
+	sched_clock_mode clockMode;
+	f64 offlineClock;
+	u32 backgroundJobCount;
+	sched_fiber_info* renderFiber;
+	f64 renderDeadline;
+	u64 eventCount;
+
+	//NOTE(martin): action output sink
+	sched_action_sink actionSink;
+	sched_action_ring actionRing;
+
+	//NOTE(martin): scratch buffer for sorting batch submissions
+	sched_batch_entry* batchScratch;
+	u32 batchScratchCapacity;
+
 } sched_info;
 
-//NOTE(martin): scheduler context
+//NOTE(martin): scheduler contexts. Each thread can bind its own context. Threads that didn't bind a context
+//              use the default context __schedInfo__.
 sched_info __schedInfo__;
+_Thread_local sched_info* __schedCurrentContext = 0;
 
 sched_info* sched_get_context()
 {
-	return(&__schedInfo__);
+	return(__schedCurrentContext ? __schedCurrentContext : &__schedInfo__);
 }
 
 //NOTE(martin): fiber entry point wrapper
@@ -251,27 +459,85 @@ i64 sched_fiber_start(fiber_context* context)
 // Handle system
 //-------------------------------------------------------------------------------------------------------
 
+void sched_handle_table_init(sched_handle_table* table)
+{
+	for(u32 i=0; i<SCHED_HANDLE_MAX_SEGMENTS; i++)
+	{
+		table->segments[i] = 0;
+	}
+	table->nextSlot = 0;
+	ListInit(&table->freeList);
+}
+
+void sched_handle_table_release(sched_handle_table* table)
+{
+	for(u32 i=0; i<SCHED_HANDLE_MAX_SEGMENTS; i++)
+	{
+		sched_handle_slot* segment = table->segments[i];
+		if(!segment)
+		{
+			break;
+		}
+		free(segment);
+		table->segments[i] = 0;
+	}
+	table->nextSlot = 0;
+	ListInit(&table->freeList);
+}
+
+sched_handle_slot* sched_handle_table_get_slot(sched_handle_table* table, u32 index)
+{
+	//NOTE(martin): the caller must have checked that index < nextSlot, which guarantees that the segment was published
+	sched_handle_slot* segment = table->segments[index / SCHED_HANDLE_SEGMENT_SIZE];
+	return(&(segment[index % SCHED_HANDLE_SEGMENT_SIZE]));
+}
+
 sched_handle_slot* sched_alloc_handle_slot(sched_info* sched)
 {
+	sched_handle_table* table = &sched->handles;
 	sched_handle_slot* slot = 0;
-	if(ListEmpty(&sched->handleFreeList))
+	if(ListEmpty(&table->freeList))
 	{
-		if(sched->nextHandleSlot >= SCHED_MAX_HANDLE_SLOTS)
+		u32 index = table->nextSlot;
+		u32 segmentIndex = index / SCHED_HANDLE_SEGMENT_SIZE;
+
+		if(segmentIndex >= SCHED_HANDLE_MAX_SEGMENTS)
 		{
-			LOG_ERROR("Too many in-flight handles (SCHED_MAX_HANDLE_SLOTS = %u)\n", SCHED_MAX_HANDLE_SLOTS);
+			LOG_ERROR("Too many in-flight handles (max = %u)\n", SCHED_HANDLE_SEGMENT_SIZE * SCHED_HANDLE_MAX_SEGMENTS);
 			return(0);
 		}
 
-		slot = &(sched->handleSlots[sched->nextHandleSlot]);
-		sched->nextHandleSlot++;
-		slot->kind = SCHED_HANDLE_FREE;
+		sched_handle_slot* segment = table->segments[segmentIndex];
+		if(!segment)
+		{
+			//NOTE(martin): allocate a new segment. Existing segments don't move, so slot pointers stay valid.
+			segment = malloc_array(sched_handle_slot, SCHED_HANDLE_SEGMENT_SIZE);
+			if(!segment)
+			{
+				LOG_ERROR("Couldn't allocate handle table segment\n");
+				return(0);
+			}
+			table->segments[segmentIndex] = segment;
+		}
+
+		//NOTE(martin): slots past nextSlot are never read, so we initialize them when they are first allocated
+		slot = &(segment[index % SCHED_HANDLE_SEGMENT_SIZE]);
+		slot->index = index;
 		slot->generation = 1;
+		slot->kind = SCHED_HANDLE_FREE;
+		slot->object = 0;
+		slot->borrowed = false;
+		ListInit(&slot->freeListElt);
+
+		//NOTE(martin): publish the slot to lock-free readers once it is initialized
+		table->nextSlot = index + 1;
 	}
 	else
 	{
-		slot = ListEntry(ListPop(&sched->handleFreeList), sched_handle_slot, freeListElt);
+		slot = ListEntry(ListPop(&table->freeList), sched_handle_slot, freeListElt);
 	}
 	DEBUG_ASSERT(slot->kind == SCHED_HANDLE_FREE);
+	slot->borrowed = false;
 	return(slot);
 }
 
@@ -282,44 +548,59 @@ sched_handle_slot* sched_handle_slot_find_kind(sched_info* sched, u64 h, sched_h
 	u32 generation = (u32)(h & 0xffffffff);
 	u32 index = (u32)(h>>32);
 
-	DEBUG_ASSERT(index < sched->nextHandleSlot);
+	DEBUG_ASSERT(index < sched->handles.nextSlot);
 
-	sched_handle_slot*  slot = &(sched->handleSlots[index]);
+	sched_handle_slot* slot = sched_handle_table_get_slot(&sched->handles, index);
 	DEBUG_ASSERT(slot->generation == generation);
 	DEBUG_ASSERT(slot->kind == kind);
 	return(slot);
 }
 
-sched_handle_slot_kind sched_handle_slot_find_generic(sched_info* sched, u64 h, sched_handle_slot** outSlot)
+sched_handle_slot_kind sched_handle_slot_find_generic(sched_info* sched, u64 h, sched_handle_lookup* out)
 {
+	//NOTE(martin): this function can be called from any thread. The payload is copied to out, and the generation is
+	//              checked again afterwards, so that we don't return the payload of a slot that was recycled in between.
+	//              Note that only the scheduler thread can dereference the returned object, since other threads can't
+	//              prevent it from being recycled.
 	u32 generation = (u32)(h & 0xffffffff);
 	u32 index = (u32)(h>>32);
 
-	if(index >= sched->nextHandleSlot)
+	if(index >= sched->handles.nextSlot)
 	{
 		return(SCHED_HANDLE_INVALID);
 	}
 
-	sched_handle_slot*  slot = &(sched->handleSlots[index]);
+	sched_handle_slot* slot = sched_handle_table_get_slot(&sched->handles, index);
+	if(slot->generation != generation)
+	{
+		return(SCHED_HANDLE_INVALID);
+	}
+	sched_handle_slot_kind kind = slot->kind;
+	void* object = slot->object;
+	bool borrowed = slot->borrowed;
 	if(slot->generation != generation)
 	{
 		return(SCHED_HANDLE_INVALID);
 	}
-	*outSlot = slot;
-	return(slot->kind);
+	out->slot = slot;
+	out->object = object;
+	out->borrowed = borrowed;
+	return(kind);
 }
 
 void sched_handle_slot_recycle(sched_info* sched, sched_handle_slot* slot)
 {
-	slot->kind = SCHED_HANDLE_FREE;
+	//NOTE(martin): bump the generation first, so that concurrent readers can't validate the slot while it is being recycled
 	slot->generation++;
-	ListPush(&sched->handleFreeList, &slot->freeListElt);
+	slot->kind = SCHED_HANDLE_FREE;
+	slot->object = 0;
+	ListPush(&sched->handles.freeList, &slot->freeListElt);
 }
 
 u64 sched_handle_slot_get_packed_handle(sched_info* sched, sched_handle_slot* slot)
 {
 	u64 generation = (u64)slot->generation;
-	u64 index = (u64)(slot - sched->handleSlots);
+	u64 index = (u64)slot->index;
 	u64 h = index<<32 | generation;
 	return(h);
 }
@@ -332,14 +613,40 @@ sched_task sched_alloc_task_handle(sched_info* sched, sched_task_info* task)
 		return((sched_task){.h = 0});
 	}
 	slot->kind = SCHED_HANDLE_TASK;
-	slot->task = task;
+	slot->object = task;
 	return((sched_task){.h = sched_handle_slot_get_packed_handle(sched, slot)});
 }
 
 sched_task_info* sched_handle_get_task_ptr(sched_info* sched, sched_task handle)
 {
 	sched_handle_slot* slot = sched_handle_slot_find_kind(sched, handle.h, SCHED_HANDLE_TASK);
-	return(slot->task);
+	void* object = slot->object;
+	return((sched_task_info*)object);
+}
+
+void sched_recycle_borrowed_handle(sched_info* sched, u64 h)
+{
+	sched_handle_lookup lookup;
+	if(h && sched_handle_slot_find_generic(sched, h, &lookup) != SCHED_HANDLE_INVALID)
+	{
+		DEBUG_ASSERT(lookup.borrowed);
+		sched_handle_slot_recycle(sched, lookup.slot);
+	}
+}
+
+sched_task sched_get_task_self_handle(sched_info* sched, sched_task_info* task)
+{
+	//NOTE(martin): lazily allocate a borrowed handle and cache it in the task. It doesn't increment openHandles,
+	//              and is recycled with the task.
+	if(!task->selfHandle.h)
+	{
+		task->selfHandle = sched_alloc_task_handle(sched, task);
+		if(task->selfHandle.h)
+		{
+			sched_handle_slot_find_kind(sched, task->selfHandle.h, SCHED_HANDLE_TASK)->borrowed = true;
+		}
+	}
+	return(task->selfHandle);
 }
 
 sched_fiber sched_alloc_fiber_handle(sched_info* sched, sched_fiber_info* fiber)
@@ -350,58 +657,81 @@ sched_fiber sched_alloc_fiber_handle(sched_info* sched, sched_fiber_info* fiber)
 		return((sched_fiber){.h = 0});
 	}
 	slot->kind = SCHED_HANDLE_FIBER;
-	slot->fiber = fiber;
+	slot->object = fiber;
 	return((sched_fiber){.h = sched_handle_slot_get_packed_handle(sched, slot)});
 }
 
 sched_fiber_info* sched_handle_get_fiber_ptr(sched_info* sched, sched_fiber handle)
 {
 	sched_handle_slot* slot = sched_handle_slot_find_kind(sched, handle.h, SCHED_HANDLE_FIBER);
-	return(slot->fiber);
+	void* object = slot->object;
+	return((sched_fiber_info*)object);
 }
 
-//-------------------------------------------------------------------------------------------------------
-// Clock / Condition wrappers
-//-------------------------------------------------------------------------------------------------------
-
-#ifndef SCHED_OFFLINE // real-time scheduler wrappers
-
-f64 sched_clock_get_time()
+sched_fiber sched_get_fiber_self_handle(sched_info* sched, sched_fiber_info* fiber)
 {
-	return(ClockGetTime(SYS_CLOCK_MONOTONIC));
+	//NOTE(martin): see sched_get_task_self_handle()
+	if(!fiber->selfHandle.h)
+	{
+		fiber->selfHandle = sched_alloc_fiber_handle(sched, fiber);
+		if(fiber->selfHandle.h)
+		{
+			sched_handle_slot_find_kind(sched, fiber->selfHandle.h, SCHED_HANDLE_FIBER)->borrowed = true;
+		}
+	}
+	return(fiber->selfHandle);
 }
 
-void sched_condition_timed_wait(platform_condition* cond, platform_mutex* mutex, f64 timeout)
+sched_timer sched_alloc_timer_handle(sched_info* sched, sched_timer_info* timer)
 {
-	ConditionTimedWait(cond, mutex, timeout);
+	sched_handle_slot* slot = sched_alloc_handle_slot(sched);
+	if(!slot)
+	{
+		return((sched_timer){.h = 0});
+	}
+	slot->kind = SCHED_HANDLE_TIMER;
+	slot->object = timer;
+	return((sched_timer){.h = sched_handle_slot_get_packed_handle(sched, slot)});
 }
 
-void sched_condition_wait(platform_condition* cond, platform_mutex* mutex)
+sched_timer_info* sched_handle_get_timer_ptr(sched_info* sched, sched_timer handle)
 {
-	ConditionWait(cond, mutex);
+	sched_handle_slot* slot = sched_handle_slot_find_kind(sched, handle.h, SCHED_HANDLE_TIMER);
+	void* object = slot->object;
+	return((sched_timer_info*)object);
 }
 
-#else // offline scheduler wrappers
-
-f64 __offlineClock = 0;
-
-f64 sched_clock_get_time()
+sched_action_handle sched_alloc_action_handle(sched_info* sched, sched_action_info* action)
 {
-	return(__offlineClock);
+	//NOTE(martin): action handles are borrowed: they are owned by the action and recycled when it fires or is cancelled
+	sched_handle_slot* slot = sched_alloc_handle_slot(sched);
+	if(!slot)
+	{
+		return((sched_action_handle){.h = 0});
+	}
+	slot->kind = SCHED_HANDLE_ACTION;
+	slot->object = action;
+	slot->borrowed = true;
+	return((sched_action_handle){.h = sched_handle_slot_get_packed_handle(sched, slot)});
 }
 
-void sched_condition_timed_wait(platform_condition* cond, platform_mutex* mutex, f64 timeout)
-{
-	__offlineClock += timeout;
-}
+//-------------------------------------------------------------------------------------------------------
+// Clock / Condition wrappers
+//-------------------------------------------------------------------------------------------------------
 
-void sched_condition_wait(platform_condition* cond, platform_mutex* mutex)
+f64 sched_clock_get_time(sched_info* sched)
 {
-	ConditionWait(cond, mutex);
+	//NOTE(martin): offline schedulers run on a virtual clock, which is only advanced by sched_offline_advance_clock()
+	if(sched->clockMode == SCHED_CLOCK_OFFLINE)
+	{
+		return(sched->offlineClock);
+	}
+	else
+	{
+		return(ClockGetTime(SYS_CLOCK_MONOTONIC));
+	}
 }
 
-#endif // #ifndef SCHED_OFFLINE
-
 //-------------------------------------------------------------------------------------------------------
 // Tasks position updates functions
 //-------------------------------------------------------------------------------------------------------
@@ -415,6 +745,22 @@ f64 sched_task_update_pos_from_sync_scaling(sched_info* sched, sched_task_info*
 	return(posUpdate);
 }
 
+void sched_background_queue_push_prewarm(sched_info* sched, sched_curve* curve, f64 time);
+
+void sched_task_prewarm_curve(sched_info* sched, sched_task_info* task)
+{
+	//NOTE(martin): for lazy curves, ask the background workers to integrate the curve ahead of the task's location,
+	//              so that its queries don't integrate on the scheduler thread. We request twice the window every
+	//              window, to avoid posting a request at each update.
+	if(sched_curve_is_integrated(task->tempoCurve)
+	  || task->srcLoc + SCHED_CURVE_PREWARM_WINDOW <= task->tempoPrewarmTime)
+	{
+		return;
+	}
+	task->tempoPrewarmTime = task->srcLoc + 2*SCHED_CURVE_PREWARM_WINDOW;
+	sched_background_queue_push_prewarm(sched, task->tempoCurve, task->tempoPrewarmTime);
+}
+
 f64 sched_task_update_pos_from_sync_curve(sched_info* sched, sched_task_info* task, sched_steps timeElapsed)
 {
 	DEBUG_ASSERT(task->tempoCurve);
@@ -422,7 +768,7 @@ f64 sched_task_update_pos_from_sync_curve(sched_info* sched, sched_task_info* ta
 
 	f64 newSrcLoc = task->srcLoc + timeElapsed;
 	f64 newSelfLoc = 0;
-	sched_curve_get_position_from_time(task->tempoCurve, newSrcLoc, &newSelfLoc);
+	sched_curve_cursor_get_position_from_time(task->tempoCurve, &task->tempoCursor, newSrcLoc, &newSelfLoc);
 
 	//TODO: potential loss of significance, get update directly from curve?
 	f64 posUpdate = newSelfLoc - task->selfLoc;
@@ -430,6 +776,8 @@ f64 sched_task_update_pos_from_sync_curve(sched_info* sched, sched_task_info* ta
 	task->srcLoc = newSrcLoc;
 	task->logicalLoc = task->selfLoc;
 
+	sched_task_prewarm_curve(sched, task);
+
 	return(posUpdate);
 }
 
@@ -543,17 +891,181 @@ void sched_fiber_reschedule_in_steps(sched_info* sched, sched_fiber_info* fiber,
 
 void sched_do_foreground_cmd(sched_info* sched, sched_fiber_info* fiber)
 {
-	ListRemove(&fiber->listElt);
+	sched->backgroundJobCount--;
+	ListRemove(&fiber->event.listElt);
 	fiber->status = SCHED_STATUS_ACTIVE;
 	sched_fiber_reschedule_in_steps(sched, fiber, 0);
 }
 
+void sched_fiber_resume_ptr(sched_info* sched, sched_fiber_info* fiber);
+
+void sched_do_render_deadline_cmd(sched_info* sched)
+{
+	sched_fiber_info* fiber = sched->renderFiber;
+	sched->renderFiber = 0;
+	if(fiber && fiber->status == SCHED_STATUS_SUSPENDED)
+	{
+		sched_fiber_resume_ptr(sched, fiber);
+	}
+}
+
+//NOTE(martin): commands posted from other threads can carry handles that went stale in the meantime, so we
+//              validate them here rather than asserting like sched_handle_get_xxx_ptr() does.
+
 void sched_do_wakeup_cmd(sched_info* sched, sched_fiber fiberHandle)
 {
-	sched_fiber_info* fiber = sched_handle_get_fiber_ptr(sched, fiberHandle);
+	sched_handle_lookup lookup;
+	if(sched_handle_slot_find_generic(sched, fiberHandle.h, &lookup) != SCHED_HANDLE_FIBER)
+	{
+		LOG_WARNING("wakeup command for an invalid fiber handle\n");
+		return;
+	}
+	sched_fiber_info* fiber = lookup.fiber;
 	if(fiber->status == SCHED_STATUS_SUSPENDED)
 	{
-		sched_fiber_resume(fiberHandle);
+		sched_fiber_resume_ptr(sched, fiber);
+	}
+}
+
+sched_task_info* sched_command_get_task_ptr(sched_info* sched, sched_task task)
+{
+	sched_handle_lookup lookup;
+	if(sched_handle_slot_find_generic(sched, task.h, &lookup) != SCHED_HANDLE_TASK
+	  || lookup.task->status == SCHED_STATUS_COMPLETED)
+	{
+		return(0);
+	}
+	return(lookup.task);
+}
+
+sched_fiber_info* sched_fiber_create_with_task_ptr(sched_info* sched, sched_task_info* task, sched_fiber_proc proc, void* userPointer, sched_steps steps);
+
+void sched_do_fiber_create_cmd(sched_info* sched, sched_task task, sched_fiber_proc proc, void* userPointer)
+{
+	sched_task_info* taskPtr = sched_command_get_task_ptr(sched, task);
+	if(!taskPtr)
+	{
+		LOG_WARNING("fiber create command for an invalid task handle\n");
+		return;
+	}
+	sched_fiber_create_with_task_ptr(sched, taskPtr, proc, userPointer, 0);
+}
+
+void sched_task_set_cancel_actions(sched_task task, bool cancelActions)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* taskPtr = sched_handle_get_task_ptr(sched, task);
+	taskPtr->cancelActions = cancelActions;
+
+	if(!cancelActions)
+	{
+		for_each_in_list_safe(&taskPtr->pendingActions, action, sched_action_info, taskElt)
+		{
+			ListRemove(&action->taskElt);
+		}
+	}
+}
+
+void sched_task_timescale_set_scaling_ptr(sched_info* sched, sched_task_info* task, f64 scaling);
+
+void sched_do_task_set_scaling_cmd(sched_info* sched, sched_task task, f64 scaling)
+{
+	sched_task_info* taskPtr = sched_command_get_task_ptr(sched, task);
+	if(!taskPtr)
+	{
+		LOG_WARNING("set scaling command for an invalid task handle\n");
+		return;
+	}
+	sched_task_timescale_set_scaling_ptr(sched, taskPtr, scaling);
+}
+
+void sched_task_timescale_set_curve_ptr(sched_info* sched, sched_task_info* task, sched_curve* curve);
+
+void sched_do_task_set_curve_cmd(sched_info* sched, sched_task task, sched_curve* curve)
+{
+	//NOTE(martin): the message holds a reference to the curve, which we release once the task has taken its own
+	sched_task_info* taskPtr = sched_command_get_task_ptr(sched, task);
+	if(!taskPtr)
+	{
+		LOG_WARNING("set curve command for an invalid task handle\n");
+	}
+	else
+	{
+		sched_task_timescale_set_curve_ptr(sched, taskPtr, curve);
+	}
+	sched_curve_release(curve);
+}
+
+void sched_command_execute(sched_info* sched, sched_message* message)
+{
+	switch(message->kind)
+	{
+		case SCHED_MESSAGE_WAKEUP:
+			sched_do_wakeup_cmd(sched, message->fiberHandle);
+			break;
+		case SCHED_MESSAGE_FIBER_CREATE:
+			sched_do_fiber_create_cmd(sched, message->fiberCreate.task, message->fiberCreate.proc, message->fiberCreate.userPointer);
+			break;
+		case SCHED_MESSAGE_TASK_SET_SCALING:
+			sched_do_task_set_scaling_cmd(sched, message->taskScaling.task, message->taskScaling.scaling);
+			break;
+		case SCHED_MESSAGE_TASK_SET_CURVE:
+			sched_do_task_set_curve_cmd(sched, message->taskCurve.task, message->taskCurve.curve);
+			break;
+		default:
+			DEBUG_ASSERT(0, "unexpected deferred command kind");
+			break;
+	}
+}
+
+void sched_command_execute_deferred(void* userPointer)
+{
+	sched_command_execute(sched_get_context(), (sched_message*)userPointer);
+}
+
+void sched_command_release(sched_message* message)
+{
+	//NOTE(martin): release the references held by a command that is dropped without being executed
+	if(message->kind == SCHED_MESSAGE_TASK_SET_CURVE)
+	{
+		sched_curve_release(message->taskCurve.curve);
+	}
+}
+
+f64 sched_command_get_delay(sched_info* sched, f64 timestamp)
+{
+	//NOTE(martin): timestamped commands take effect at timestamp + lookAheadWindow, so that they all get the same
+	//              latency regardless of when the scheduler gets to dispatch them. Commands without a timestamp,
+	//              or that are already late, take effect immediately.
+	//              Delays are relative to lastTimeUpdate, which was just updated when picking the messages.
+	if(timestamp <= 0)
+	{
+		return(0);
+	}
+	return(maximum(0., timestamp + sched->lookAheadWindow - sched->lastTimeUpdate));
+}
+
+sched_action_info* sched_action_alloc(sched_info* sched, sched_task_info* task, sched_action_callback callback, u32 size, char* data, void* userPointer);
+void sched_action_schedule(sched_info* sched, sched_action_info* action, f64 delayFromNow);
+sched_action_info* sched_action_emit(sched_info* sched, sched_task_info* task, sched_action_callback callback, u32 size, char* data, void* userPointer, f64 delayFromNow);
+
+void sched_do_action_cmd(sched_info* sched, sched_message* message)
+{
+	sched_action_emit(sched, 0, message->action.callback, message->action.size, message->action.data, 0, sched_command_get_delay(sched, message->timestamp));
+}
+
+void sched_do_command(sched_info* sched, sched_message* message)
+{
+	f64 delay = sched_command_get_delay(sched, message->timestamp);
+	if(delay > 0)
+	{
+		//NOTE(martin): defer the command by wrapping a copy of the message in an action
+		sched_action_info* action = sched_action_alloc(sched, 0, sched_command_execute_deferred, sizeof(sched_message), (char*)message, 0);
+		sched_action_schedule(sched, action, delay);
+	}
+	else
+	{
+		sched_command_execute(sched, message);
 	}
 }
 
@@ -568,7 +1080,7 @@ void sched_wait_for_message(sched_info* sched)
 	{
 		//NOTE(martin): wait on the command condition, which releases the command mutex, which
 		//              allow other threads to commit command buffers to the command queue
-		sched_condition_wait(sched->msgCondition, sched->msgConditionMutex);
+		ConditionWait(sched->msgCondition, sched->msgConditionMutex);
 	}
 	MutexUnlock(sched->msgConditionMutex);
 }
@@ -588,9 +1100,9 @@ void sched_wait_for_message_or_timeout(sched_info* sched, f64 timeout)
 		//              This also allows to gracefully handle spurious wakeups.
 		//TODO(martin): do more precise measurement of timeout accuracy and choose ratio accordingly.
 
-		f64 lastStart = sched_clock_get_time();
-		sched_condition_timed_wait(sched->msgCondition, sched->msgConditionMutex, timeout * 0.8);
-		timeout -= sched_clock_get_time() - lastStart;
+		f64 lastStart = sched_clock_get_time(sched);
+		ConditionTimedWait(sched->msgCondition, sched->msgConditionMutex, timeout * 0.8);
+		timeout -= sched_clock_get_time(sched) - lastStart;
 	}
 	MutexUnlock(sched->msgConditionMutex);
 }
@@ -629,14 +1141,58 @@ void sched_dispatch_commands(sched_info* sched)
 			case SCHED_MESSAGE_FOREGROUND:
 				sched_do_foreground_cmd(sched, message->fiber);
 				break;
+			case SCHED_MESSAGE_RENDER_DEADLINE:
+				sched_do_render_deadline_cmd(sched);
+				break;
+			case SCHED_MESSAGE_ACTION:
+				sched_do_action_cmd(sched, message);
+				break;
 			case SCHED_MESSAGE_WAKEUP:
-				sched_do_wakeup_cmd(sched, message->fiberHandle);
+			case SCHED_MESSAGE_FIBER_CREATE:
+			case SCHED_MESSAGE_TASK_SET_SCALING:
+			case SCHED_MESSAGE_TASK_SET_CURVE:
+				sched_do_command(sched, message);
 				break;
-			//...
 		}
 	}
 }
 
+sched_message* sched_message_acquire(sched_info* sched);
+void sched_message_commit(sched_info* sched, sched_message* message);
+
+void sched_offline_advance_clock(sched_info* sched, f64 timeout)
+{
+	//NOTE(martin): in offline mode, we don't sleep: the virtual clock jumps directly to the next deadline.
+	//              We still block while background jobs are running, so that they always come back at the
+	//              same virtual time, regardless of how long they really take.
+	if(sched->hasMessages)
+	{
+		return;
+	}
+	if(sched->backgroundJobCount)
+	{
+		sched_wait_for_message(sched);
+	}
+	else if(sched->renderFiber && (sched->offlineClock + timeout > sched->renderDeadline))
+	{
+		//NOTE(martin): stop at the render deadline and post a message to wake up the render fiber
+		sched->offlineClock = maximum(sched->offlineClock, sched->renderDeadline);
+
+		sched_message* message = sched_message_acquire(sched);
+			message->kind = SCHED_MESSAGE_RENDER_DEADLINE;
+		sched_message_commit(sched, message);
+	}
+	else if(timeout == DBL_MAX)
+	{
+		//NOTE(martin): nothing is scheduled, so only another thread can wake us up
+		sched_wait_for_message(sched);
+	}
+	else
+	{
+		sched->offlineClock += timeout;
+	}
+}
+
 sched_message* sched_message_acquire(sched_info* sched)
 {
 	TicketSpinMutexLock(&sched->msgPoolMutex);
@@ -664,30 +1220,76 @@ void sched_message_commit(sched_info* sched, sched_message* message)
 // Scheduling
 //-------------------------------------------------------------------------------------------------------
 
-void sched_fiber_reschedule_in_steps(sched_info* sched, sched_fiber_info* fiber, sched_steps steps)
+void sched_event_schedule_at(sched_info* sched, sched_task_info* task, sched_event_info* event, f64 logicalLoc)
 {
-	sched_task_info* task = fiber->task;
-	fiber->logicalLoc = fiber->task->logicalLoc + steps;
-	fiber->ticket = sched->nextTicket++;
+	event->logicalLoc = logicalLoc;
+	event->ticket = sched->nextTicket++;
 
 	//NOTE(martin): insert new event in the event list. The event list is sorted by ascending location.
 	bool found = false;
-	for_each_in_list(&task->fibers, item, sched_fiber_info, listElt)
+	for_each_in_list(&task->events, item, sched_event_info, listElt)
 	{
-		if((item->logicalLoc - fiber->logicalLoc) > 0)
+		if((item->logicalLoc - event->logicalLoc) > 0)
 		{
-			ListInsertBefore(&item->listElt, &fiber->listElt);
+			ListInsertBefore(&item->listElt, &event->listElt);
 			found = true;
 			break;
 		}
 	}
 	if(!found)
 	{
-		ListAppend(&task->fibers, &fiber->listElt);
+		ListAppend(&task->events, &event->listElt);
 	}
+}
+
+void sched_fiber_reschedule_in_steps(sched_info* sched, sched_fiber_info* fiber, sched_steps steps)
+{
+	sched_task_info* task = fiber->task;
+	sched_event_schedule_at(sched, task, &fiber->event, task->logicalLoc + steps);
 	task->status = SCHED_STATUS_ACTIVE;
 }
 
+//-------------------------------------------------------------------------------------------------------
+// Batch submissions
+//-------------------------------------------------------------------------------------------------------
+
+int sched_batch_entry_compare(const void* a, const void* b)
+{
+	const sched_batch_entry* entryA = (const sched_batch_entry*)a;
+	const sched_batch_entry* entryB = (const sched_batch_entry*)b;
+
+	if(entryA->key != entryB->key)
+	{
+		return((entryA->key < entryB->key) ? -1 : 1);
+	}
+	//NOTE(martin): keep submission order for entries with the same key
+	return((entryA->index < entryB->index) ? -1 : 1);
+}
+
+sched_batch_entry* sched_batch_sort(sched_info* sched, u32 count, f64 (*getKey)(const void*, u32), const void* descs)
+{
+	if(count > sched->batchScratchCapacity)
+	{
+		sched->batchScratchCapacity = maximum(count, 2*sched->batchScratchCapacity);
+		sched->batchScratch = (sched_batch_entry*)realloc(sched->batchScratch, sizeof(sched_batch_entry)*sched->batchScratchCapacity);
+	}
+	sched_batch_entry* entries = sched->batchScratch;
+
+	bool sorted = true;
+	for(u32 i=0; i<count; i++)
+	{
+		entries[i].key = getKey(descs, i);
+		entries[i].index = i;
+		sorted = sorted && (i == 0 || entries[i].key >= entries[i-1].key);
+	}
+	//NOTE(martin): most batches (eg. chords) are submitted in order, so don't pay for the sort in that case
+	if(!sorted)
+	{
+		qsort(entries, count, sizeof(sched_batch_entry), sched_batch_entry_compare);
+	}
+	return(entries);
+}
+
 //-------------------------------------------------------------------------------------------------------
 // Fiber/tasks retirement/completion
 //-------------------------------------------------------------------------------------------------------
@@ -696,6 +1298,13 @@ void sched_task_recycle(sched_info* sched, sched_task_info* task)
 {
 	LOG_MESSAGE("recycle task %p\n", task);
 	DEBUG_ASSERT(task->tempoCurve == 0, "curves should have been be freed earlier as part of termination");
+	sched_recycle_borrowed_handle(sched, task->selfHandle.h);
+
+	//NOTE(martin): detach actions that outlive the task
+	for_each_in_list_safe(&task->pendingActions, action, sched_action_info, taskElt)
+	{
+		ListRemove(&action->taskElt);
+	}
 	mem_pool_release_block(&sched->taskPool, task);
 }
 
@@ -716,6 +1325,8 @@ void sched_fiber_recycle(sched_info* sched, sched_fiber_info* fiber)
 	DEBUG_ASSERT(fiber->status == SCHED_STATUS_COMPLETED);
 	DEBUG_ASSERT(fiber->openHandles <= 0);
 
+	sched_recycle_borrowed_handle(sched, fiber->selfHandle.h);
+
 	//NOTE(martin): free the fiber stack.
 	//WARN(martin): We now that the fiber context pointer aliases the start of the stack.
 	//              Maybe provide a special wrapper for that.
@@ -731,7 +1342,37 @@ void sched_fiber_check_if_needs_recycling(sched_info* sched, sched_fiber_info* f
 	}
 }
 
+void sched_timer_recycle(sched_info* sched, sched_timer_info* timer)
+{
+	LOG_MESSAGE("recycle timer %p\n", timer);
+	DEBUG_ASSERT(ListEmpty(&timer->waiting));
+	mem_pool_release_block(&sched->timerPool, timer);
+}
+
+void sched_timer_check_if_needs_recycling(sched_info* sched, sched_timer_info* timer)
+{
+	//NOTE(martin): a timer cancelled from its own callback is recycled by the run loop once the callback returns
+	if(timer->status == SCHED_STATUS_COMPLETED
+	  && !timer->openHandles
+	  && sched->currentTimer != timer)
+	{
+		sched_timer_recycle(sched, timer);
+	}
+}
+
 void sched_task_complete(sched_info* sched, sched_task_info* task);
+void sched_timer_cancel_ptr(sched_info* sched, sched_timer_info* timer);
+
+void sched_task_cancel_timers(sched_info* sched, sched_task_info* task)
+{
+	for_each_in_list_safe(&task->events, event, sched_event_info, listElt)
+	{
+		if(event->kind == SCHED_EVENT_TIMER)
+		{
+			sched_timer_cancel_ptr(sched, ListEntry(event, sched_timer_info, event));
+		}
+	}
+}
 
 void sched_task_notify_parent_of_completion(sched_info* sched, sched_task_info* task)
 {
@@ -758,7 +1399,7 @@ void sched_signal_waiting_fibers(sched_info* sched, list_info* waiting, sched_ob
 			fiber->status = SCHED_STATUS_ACTIVE;
 			fiber->wakeupCode = SCHED_WAKEUP_SIGNALED;
 			ListRemove(&fiber->waitingElt);
-			ListRemove(&fiber->listElt);
+			ListRemove(&fiber->event.listElt);
 			sched_fiber_reschedule_in_steps(sched, fiber, 0);
 		}
 	}
@@ -771,7 +1412,7 @@ void sched_signal_waiting_fibers_on_cancel(sched_info* sched, list_info* waiting
 		fiber->status = SCHED_STATUS_ACTIVE;
 		fiber->wakeupCode = SCHED_WAKEUP_CANCELLED;
 		ListRemove(&fiber->waitingElt);
-		ListRemove(&fiber->listElt);
+		ListRemove(&fiber->event.listElt);
 		sched_fiber_reschedule_in_steps(sched, fiber, 0);
 	}
 }
@@ -798,7 +1439,7 @@ void sched_task_complete(sched_info* sched, sched_task_info* task)
 	//NOTE(martin): free active resources of the task
 	if(task->tempoCurve)
 	{
-		sched_curve_destroy(task->tempoCurve);
+		sched_curve_release(task->tempoCurve);
 		task->tempoCurve = 0;
 	}
 
@@ -810,6 +1451,9 @@ void sched_task_retire(sched_info* sched, sched_task_info* task)
 {
 	task->status = SCHED_STATUS_IDLE;
 
+	//NOTE(martin): timers don't keep a task alive, so cancel the timers that are left in the task's event queue
+	sched_task_cancel_timers(sched, task);
+
 	//NOTE(martin): notify all fibers waiting on this task's retirement
 	sched_signal_waiting_fibers(sched, &task->waiting, SCHED_SIG_IDLE);
 
@@ -832,7 +1476,8 @@ void sched_fiber_complete(sched_info* sched, sched_fiber_info* fiber)
 	sched_signal_waiting_fibers(sched, &fiber->waiting, SCHED_SIG_COMPLETED);
 
 	//NOTE(martin): check if task as any fibers left
-	if(ListEmpty(&fiber->task->fibers) && ListEmpty(&fiber->task->suspended))
+	fiber->task->fiberCount--;
+	if(!fiber->task->fiberCount)
 	{
 		//NOTE(martin): if so, set the exit code and retire the task
 		fiber->task->exitCode = fiber->exitCode;
@@ -852,17 +1497,23 @@ void* sched_background_job_main(void* userPointer)
 {
 	LOG_DEBUG("starting worker thread\n");
 
-	sched_info* sched = (sched_info*)userPointer;
+	sched_background_worker* worker = (sched_background_worker*)userPointer;
+	sched_info* sched = worker->sched;
 	sched_job_queue* queue = &sched->jobQueue;
 
+	//NOTE(martin): bind the worker thread to the scheduler context that owns it
+	__schedCurrentContext = sched;
+
 	while(queue->running)
 	{
 		sched_fiber_info* fiber = 0;
+		sched_curve_prewarm_request prewarm = {};
 
-		//NOTE(martin): wait for a fiber to be available in the queue
+		//NOTE(martin): wait for a fiber or a curve prewarm request to be available in the queue. Fibers go first.
 		MutexLock(queue->mutex);
 		{
-			while(ListEmpty(&queue->list) && queue->running)
+			worker->busy = false;
+			while(ListEmpty(&queue->list) && !queue->prewarmCount && queue->running)
 			{
 				ConditionWait(queue->condition, queue->mutex);
 			}
@@ -871,9 +1522,25 @@ void* sched_background_job_main(void* userPointer)
 				MutexUnlock(queue->mutex);
 				goto end;
 			}
-			fiber = ListPopEntry(&queue->list, sched_fiber_info, jobQueueElt);
+			if(ListEmpty(&queue->list))
+			{
+				queue->prewarmCount--;
+				prewarm = queue->prewarmRequests[queue->prewarmCount];
+			}
+			else
+			{
+				fiber = ListPopEntry(&queue->list, sched_fiber_info, jobQueueElt);
+				worker->busy = true;
+			}
 		} MutexUnlock(queue->mutex);
 
+		if(!fiber)
+		{
+			sched_curve_prewarm(prewarm.curve, prewarm.time);
+			sched_curve_release(prewarm.curve);
+			continue;
+		}
+
 		LOG_DEBUG("picked a background job\n");
 		//NOTE(martin): yield to the fiber
 		__backgroundJobCurrentFiber = fiber;
@@ -900,31 +1567,53 @@ void sched_background_queue_init(sched_info* sched)
 	queue->mutex = MutexCreate();
 	queue->condition = ConditionCreate();
 	ListInit(&queue->list);
+	queue->prewarmCount = 0;
 
 	for(int i=0; i<SCHED_BACKGROUND_QUEUE_THREAD_COUNT; i++)
 	{
 		char name[64];
 		snprintf(name, 64, "sched_worker#%i", i);
-		queue->threads[i] = ThreadCreateWithName(sched_background_job_main, sched, name);
+		sched_background_worker* worker = &queue->workers[i];
+		worker->sched = sched;
+		worker->busy = false;
+		worker->thread = ThreadCreateWithName(sched_background_job_main, worker, name);
 	}
 }
 
 void sched_background_queue_cleanup(sched_job_queue* queue)
 {
 	/*NOTE(martin):
-		We first set queue->running to false and signal all thread. After that, we know that worker threads
-		are either soon to quit or blocked in a blocking call. In any case they won't try to take the queue
-		lock again, so we can cancel the all.
+		We first set queue->running to false and signal all thread. After that, idle workers quit on their own,
+		and busy workers are running a background fiber, possibly blocked in a blocking call, so we cancel them.
+		We only cancel busy workers, and while holding the queue lock, so that no worker is cancelled inside
+		ConditionWait(), which would make it exit with the lock held. We then join all workers, so that none of
+		them is still using the context when it is cleared or freed.
 	*/
 	MutexLock(queue->mutex);
 		queue->running = false;
 		ConditionBroadcast(queue->condition);
+
+		for(u32 i=0; i<queue->prewarmCount; i++)
+		{
+			sched_curve_release(queue->prewarmRequests[i].curve);
+		}
+		queue->prewarmCount = 0;
+
+		for(u32 i=0; i<SCHED_BACKGROUND_QUEUE_THREAD_COUNT; i++)
+		{
+			if(queue->workers[i].busy)
+			{
+				ThreadCancel(queue->workers[i].thread);
+			}
+		}
 	MutexUnlock(queue->mutex);
 
 	for(int i=0; i<SCHED_BACKGROUND_QUEUE_THREAD_COUNT; i++)
 	{
-		ThreadCancel(queue->threads[i]);
+		ThreadJoin(queue->workers[i].thread, 0);
 	}
+	ConditionDestroy(queue->condition);
+	MutexDestroy(queue->mutex);
 }
 
 void sched_background_queue_push(sched_info* sched, sched_fiber_info* fiber)
@@ -932,6 +1621,8 @@ void sched_background_queue_push(sched_info* sched, sched_fiber_info* fiber)
 	sched_job_queue* queue = &sched->jobQueue;
 
 	//NOTE(martin): put the fiber in the queue and wakeup one background job
+	sched->backgroundJobCount++;
+
 	MutexLock(queue->mutex);
 	{
 		ListAppend(&queue->list, &fiber->jobQueueElt);
@@ -939,16 +1630,191 @@ void sched_background_queue_push(sched_info* sched, sched_fiber_info* fiber)
 	} MutexUnlock(queue->mutex);
 }
 
+void sched_background_queue_push_prewarm(sched_info* sched, sched_curve* curve, f64 time)
+{
+	sched_job_queue* queue = &sched->jobQueue;
+
+	MutexLock(queue->mutex);
+	{
+		if(queue->prewarmCount < SCHED_CURVE_PREWARM_QUEUE_SIZE)
+		{
+			queue->prewarmRequests[queue->prewarmCount] = (sched_curve_prewarm_request){.curve = sched_curve_retain(curve), .time = time};
+			queue->prewarmCount++;
+			ConditionSignal(queue->condition);
+		}
+	} MutexUnlock(queue->mutex);
+}
+
+//-------------------------------------------------------------------------------------------------------
+// Action output ring
+//-------------------------------------------------------------------------------------------------------
+
+void sched_action_ring_init(sched_action_ring* ring, u32 size)
+{
+	u64 capacity = 1;
+	while(capacity < size)
+	{
+		capacity <<= 1;
+	}
+	ring->capacity = capacity;
+	ring->buffer = malloc_array(char, capacity);
+	ring->writeIndex = 0;
+	ring->readIndex = 0;
+}
+
+void sched_action_ring_release(sched_action_ring* ring)
+{
+	free(ring->buffer);
+	ring->buffer = 0;
+	ring->capacity = 0;
+	ring->writeIndex = 0;
+	ring->readIndex = 0;
+}
+
+bool sched_action_ring_push(sched_action_ring* ring, f64 time, sched_action_callback callback, u32 dataSize, char* data, void* userPointer)
+{
+	u64 recordSize = AlignUpOnPow2(sizeof(sched_action_ring_header) + dataSize, 8);
+
+	u64 writeIndex = ring->writeIndex;
+	u64 readIndex = ring->readIndex;
+	u64 offset = writeIndex & (ring->capacity - 1);
+	u64 padding = (offset + recordSize > ring->capacity) ? ring->capacity - offset : 0;
+
+	if(writeIndex + padding + recordSize - readIndex > ring->capacity)
+	{
+		return(false);
+	}
+	if(padding)
+	{
+		//NOTE(martin): gaps too small to hold a header are skipped implicitly by the consumer
+		if(padding >= sizeof(sched_action_ring_header))
+		{
+			sched_action_ring_header* pad = (sched_action_ring_header*)(ring->buffer + offset);
+			pad->recordSize = padding;
+			pad->callback = 0;
+		}
+		offset = 0;
+	}
+
+	sched_action_ring_header* header = (sched_action_ring_header*)(ring->buffer + offset);
+	header->recordSize = recordSize;
+	header->dataSize = dataSize;
+	header->time = time;
+	header->callback = callback;
+	header->userPointer = userPointer;
+	if(dataSize)
+	{
+		memcpy((char*)(header+1), data, dataSize);
+	}
+
+	//NOTE(martin): publish the record(s) to the consumer
+	ring->writeIndex = writeIndex + padding + recordSize;
+	return(true);
+}
+
 //-------------------------------------------------------------------------------------------------------
 // Actions
 //-------------------------------------------------------------------------------------------------------
 
-void sched_action_schedule(sched_info* sched, sched_action_info* action)
+void sched_action_payload_pools_init(sched_info* sched)
+{
+	for(u32 i=0; i<SCHED_ACTION_PAYLOAD_CLASS_COUNT; i++)
+	{
+		u64 blockSize = 1ULL<<(SCHED_ACTION_PAYLOAD_MIN_SIZE_LOG2 + i);
+		mem_pool_options options = {.base = 0, .reserve = maximum(SCHED_ACTION_PAYLOAD_POOL_MIN_RESERVE, blockSize * 1024)};
+		mem_pool_init_with_options(&sched->actionPayloadPools[i], blockSize, &options);
+	}
+}
+
+void sched_action_payload_pools_release(sched_info* sched)
+{
+	for(u32 i=0; i<SCHED_ACTION_PAYLOAD_CLASS_COUNT; i++)
+	{
+		mem_pool_release(&sched->actionPayloadPools[i]);
+	}
+}
+
+u32 sched_action_payload_class(u32 size)
+{
+	DEBUG_ASSERT(size <= SCHED_ACTION_PAYLOAD_MAX_SIZE);
+	u32 sizeClass = 0;
+	while((1U<<(SCHED_ACTION_PAYLOAD_MIN_SIZE_LOG2 + sizeClass)) < size)
+	{
+		sizeClass++;
+	}
+	return(sizeClass);
+}
+
+void sched_action_payload_release(sched_info* sched, sched_action_info* action)
+{
+	if(action->payloadClass != SCHED_ACTION_PAYLOAD_NONE)
+	{
+		mem_pool_release_block(&sched->actionPayloadPools[action->payloadClass], action->userPointer);
+	}
+}
+
+sched_action_info* sched_action_alloc(sched_info* sched, sched_task_info* task, sched_action_callback callback, u32 size, char* data, void* userPointer)
+{
+	//NOTE(martin): size == 0 means a no-copy action whose payload is userPointer
+	sched_action_info* action = mem_pool_alloc_type(&sched->actionPool, sched_action_info);
+
+	action->callback = callback;
+	action->handle = 0;
+	action->taskElt = (list_info){.next = 0, .prev = 0};
+	action->staged = false;
+	action->dataSize = size;
+	action->time = 0;
+
+	if(!size)
+	{
+		action->payloadClass = SCHED_ACTION_PAYLOAD_NONE;
+		action->userPointer = userPointer;
+	}
+	else
+	{
+		action->payloadClass = sched_action_payload_class(size);
+		action->userPointer = mem_pool_alloc_block(&sched->actionPayloadPools[action->payloadClass]);
+		memcpy(action->userPointer, data, size);
+	}
+
+	if(task && task->cancelActions)
+	{
+		ListAppend(&task->pendingActions, &action->taskElt);
+	}
+	return(action);
+}
+
+void sched_action_recycle(sched_info* sched, sched_action_info* action)
+{
+	sched_action_payload_release(sched, action);
+	ListRemove(&action->taskElt);
+	sched_recycle_borrowed_handle(sched, action->handle);
+	mem_pool_release_block(&sched->actionPool, action);
+}
+
+void sched_action_cancel_ptr(sched_info* sched, sched_action_info* action)
+{
+	if(!action->listElt.next)
+	{
+		//NOTE(martin): the action was already picked and is running, it will be recycled when its callback returns
+		return;
+	}
+	//NOTE(martin): since action delays are relative to the previous action, we can unlink the action in O(1) by
+	//              carrying its delay over to the next one.
+	list_info* next = action->listElt.next;
+	if(next != ListEnd(&sched->actions))
+	{
+		ListEntry(next, sched_action_info, listElt)->delay += action->delay;
+	}
+	ListRemove(&action->listElt);
+	sched_action_recycle(sched, action);
+}
+
+void sched_action_schedule(sched_info* sched, sched_action_info* action, f64 delayFromNow)
 {
 	//NOTE(martin): insert new action in the action list. The action list is sorted by ascending time.
 	//              action delays are relative to the previous action (or to logical time for the first one)
 
-	f64 delayFromNow = sched->lookAhead;
 	f64 cumulatedDelay = 0;
 
 	for_each_in_list(&sched->actions, item, sched_action_info, listElt)
@@ -970,15 +1836,131 @@ void sched_action_schedule(sched_info* sched, sched_action_info* action)
 	ListAppend(&sched->actions, &action->listElt);
 }
 
+void sched_action_ring_emit(sched_info* sched, f64 time, sched_action_callback callback, u32 size, char* data, void* userPointer)
+{
+	if(!sched_action_ring_push(&sched->actionRing, time, callback, size, data, userPointer))
+	{
+		LOG_ERROR("action output ring is full, dropping action\n");
+	}
+}
+
+void sched_action_ring_flush(sched_info* sched)
+{
+	//NOTE(martin): push the staged actions that the logical time has reached, so that the ring only holds near-term
+	//              records. Deferred commands are left in the queue.
+	f64 logicalTime = sched->lastTimeUpdate + sched->lookAhead;
+
+	for_each_in_list_safe(&sched->actions, action, sched_action_info, listElt)
+	{
+		if(!action->staged)
+		{
+			continue;
+		}
+		if(action->time > logicalTime)
+		{
+			break;
+		}
+		sched_action_ring_emit(sched, action->time, action->callback, action->dataSize, (char*)action->userPointer, action->userPointer);
+		sched_action_cancel_ptr(sched, action);
+	}
+}
+
+sched_action_info* sched_action_emit(sched_info* sched, sched_task_info* task, sched_action_callback callback, u32 size, char* data, void* userPointer, f64 delayFromNow)
+{
+	//NOTE(martin): emit a user action to the action queue. In ring mode, actions that are due by the current logical
+	//              time are pushed to the output ring right away, and later ones are staged in the action queue until
+	//              the logical time reaches them. Returns the queued action, or 0 if it was sent to the ring or dropped.
+	if(size > SCHED_ACTION_PAYLOAD_MAX_SIZE)
+	{
+		LOG_ERROR("action payload too big (%u bytes, max is %u)\n", size, SCHED_ACTION_PAYLOAD_MAX_SIZE);
+		return(0);
+	}
+	if(sched->actionSink == SCHED_ACTION_SINK_RING && delayFromNow <= sched->lookAhead)
+	{
+		sched_action_ring_flush(sched);
+		sched_action_ring_emit(sched, sched->lastTimeUpdate + delayFromNow, callback, size, data, userPointer);
+		return(0);
+	}
+
+	sched_action_info* action = sched_action_alloc(sched, task, callback, size, data, userPointer);
+	if(sched->actionSink == SCHED_ACTION_SINK_RING)
+	{
+		action->staged = true;
+		action->time = sched->lastTimeUpdate + delayFromNow;
+	}
+	sched_action_schedule(sched, action, delayFromNow);
+	return(action);
+}
+
+sched_task_info* sched_get_current_task(sched_info* sched)
+{
+	//NOTE(martin): timer callbacks run on the scheduler fiber, on behalf of their task. Action callbacks don't belong
+	//              to any task.
+	if(sched->currentTimer)
+	{
+		return(sched->currentTimer->task);
+	}
+	return(sched->currentFiber ? sched->currentFiber->task : 0);
+}
+
+f64 sched_action_delay_from_steps(sched_info* sched, sched_task_info* task, sched_steps steps)
+{
+	//NOTE(martin): task->logicalLoc is the location of the running fiber or timer, which is lookAhead ahead of the
+	//              scheduler's current time. task->selfLoc is the task's location at the current logical time.
+	f64 localDelay = task->logicalLoc - task->selfLoc + steps;
+	if(localDelay == 0)
+	{
+		return(sched->lookAhead);
+	}
+	return(sched->lookAhead + sched_local_to_global_delay(sched, task, localDelay));
+}
+
 void sched_action_execute(sched_info* sched, sched_action_info* action)
 {
-	action->callback(action->userPointer);
+	//NOTE(martin): the action was unlinked from the queue when it was picked. Also detach it from its task and retire
+	//              its handle before calling it, so that it can't be cancelled from its own callback, either through
+	//              its handle or by cancelling its task.
+	ListRemove(&action->taskElt);
+	sched_recycle_borrowed_handle(sched, action->handle);
+	action->handle = 0;
 
-	if(action->allocatedData)
+	if(action->staged)
 	{
-		free(action->userPointer);
+		//NOTE(martin): a staged action fell due before the logical time reached it, eg. while the scheduler was idle
+		sched_action_ring_emit(sched, action->time, action->callback, action->dataSize, (char*)action->userPointer, action->userPointer);
+	}
+	else
+	{
+		action->callback(action->userPointer);
+	}
+	sched_action_recycle(sched, action);
+}
+
+//-------------------------------------------------------------------------------------------------------
+// Timers
+//-------------------------------------------------------------------------------------------------------
+
+void sched_timer_execute(sched_info* sched, sched_timer_info* timer)
+{
+	//NOTE(martin): set the task loc and call the timer's callback on the scheduler fiber
+	sched_task_info* task = timer->task;
+	task->logicalLoc = timer->event.logicalLoc;
+
+	sched->currentTimer = timer;
+	timer->callback(timer->userPointer);
+	sched->currentTimer = 0;
+
+	if(timer->status == SCHED_STATUS_COMPLETED)
+	{
+		//NOTE(martin): the timer was cancelled by its callback
+		sched_timer_check_if_needs_recycling(sched, timer);
+	}
+	else
+	{
+		//NOTE(martin): reschedule relative to the timer's previous date rather than the current location, so that
+		//              periodic timers don't drift
+		sched_event_schedule_at(sched, task, &timer->event, timer->event.logicalLoc + timer->period);
 	}
-	mem_pool_release_block(&sched->actionPool, action);
 }
 
 //-------------------------------------------------------------------------------------------------------
@@ -986,10 +1968,10 @@ void sched_action_execute(sched_info* sched, sched_action_info* action)
 //-------------------------------------------------------------------------------------------------------
 
 typedef enum { SCHED_PICKED_ACTION,
-               SCHED_PICKED_FIBER,
+               SCHED_PICKED_EVENT,
 	       SCHED_PICKED_MESSAGE } sched_picked_event_kind;
 
-int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_action_info** outAction)
+int sched_pick_event(sched_info* sched, sched_event_info** outEvent, sched_action_info** outAction)
 {
 	//NOTE(martin): get the next action and its delay from the action list
 
@@ -1003,36 +1985,36 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 		actionDelay = nextAction->delay;
 	}
 
-	//NOTE(martin): get the next fiber and its delay: check head of each task's event queue,
+	//NOTE(martin): get the next event (fiber or timer) and its delay: check head of each task's event queue,
 	//              translate dates to global task and choose the soonest
-	sched_fiber_info* nextFiber = 0;
+	sched_event_info* nextFiber = 0;
 	f64 fiberDelay = DBL_MAX;
 	f64 fiberDelayFromLogicalTime = DBL_MAX;
 
 	for_each_in_list(&sched->runningTasks, task, sched_task_info, listElt)
 	{
-		list_info* head = ListBegin(&task->fibers);
-		if(head != ListEnd(&task->fibers))
+		list_info* head = ListBegin(&task->events);
+		if(head != ListEnd(&task->events))
 		{
-			sched_fiber_info* fiber = ListEntry(head, sched_fiber_info, listElt);
+			sched_event_info* event = ListEntry(head, sched_event_info, listElt);
 
-			f64 localDelay = fiber->logicalLoc - task->selfLoc;
+			f64 localDelay = event->logicalLoc - task->selfLoc;
 			f64 delay = sched_local_to_global_delay(sched, task, localDelay);
 
 			LOG_DEBUG("event globalDelay: %f, event logicalLoc: %f, task logicalLoc: %f \n",
 				     delay,
-				     fiber->logicalLoc,
+				     event->logicalLoc,
 				     task->selfLoc);
 
 			if(delay < fiberDelay)
 			{
 				fiberDelay = delay;
-				nextFiber = fiber;
+				nextFiber = event;
 			}
 			else if( ((delay - fiberDelay) < SCHEDULER_FUSION_THRESHOLD)
-			       &&(fiber->ticket < nextFiber->ticket))
+			       &&(event->ticket < nextFiber->ticket))
 			{
-				nextFiber = fiber;
+				nextFiber = event;
 			}
 		}
 	}
@@ -1051,10 +2033,14 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 		nextEventIsAction = actionDelay < windowShiftToNextFiber;
 		logicalTimeout = nextEventIsAction ? actionDelay : windowShiftToNextFiber;
 
-		if(logicalTimeout > 0)
+		if(logicalTimeout > 0 && sched->clockMode == SCHED_CLOCK_OFFLINE)
+		{
+			sched_offline_advance_clock(sched, logicalTimeout);
+		}
+		else if(logicalTimeout > 0)
 		{
 			//NOTE(martin): compute real timeout and sleep
-			f64 workingTime = sched_clock_get_time() - sched->lastTimeUpdate;
+			f64 workingTime = sched_clock_get_time(sched) - sched->lastTimeUpdate;
 			f64 realTimeout = logicalTimeout + sched->timeToSleepResidue - workingTime; //TODO: call timeToSleepResidue realTimeoutResidue
 
 			if(realTimeout <= 0)
@@ -1067,6 +2053,10 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 			}
 		}
 	}
+	else if(sched->clockMode == SCHED_CLOCK_OFFLINE)
+	{
+		sched_offline_advance_clock(sched, DBL_MAX);
+	}
 	else
 	{
 		//NOTE(martin): or just wait a message
@@ -1079,7 +2069,7 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 		//NOTE(martin): wakeup after timeout. If we had a timeout, we must have a scheduled fiber or action.
 		DEBUG_ASSERT(nextFiber || nextAction);
 
-		f64 now = sched_clock_get_time();
+		f64 now = sched_clock_get_time(sched);
 		f64 timeElapsed = now - sched->lastTimeUpdate;
 		sched->lastTimeUpdate = now;
 		sched->timeToSleepResidue += (logicalTimeout - timeElapsed);
@@ -1104,21 +2094,21 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 				nextAction->delay -= logicalTimeout;
 			}
 
-			f64 fiberTimeUpdate = taskDelay;
+			f64 fiberTimeUpdate = fiberDelay;
 			sched->lookAhead = fiberDelayFromLogicalTime - logicalTimeout;
 
 			//NOTE(martin): update tasks' positions
 			sched_update_task_positions(sched, fiberTimeUpdate);
 
 			ListRemove(&nextFiber->listElt);
-			*outFiber = nextFiber;
-			return(SCHED_PICKED_FIBER);
+			*outEvent = nextFiber;
+			return(SCHED_PICKED_EVENT);
 		}
 	}
 	else
 	{
 		//NOTE(martin): wakeup after message.
-		f64 now = sched_clock_get_time();
+		f64 now = sched_clock_get_time(sched);
 		f64 timeElapsed = now - sched->lastTimeUpdate;
 		sched->lastTimeUpdate = now;
 		sched->timeToSleepResidue = 0;
@@ -1142,21 +2132,28 @@ int sched_pick_event(sched_info* sched, sched_fiber_info** outFiber, sched_actio
 
 i64 sched_run(void* userPointer)
 {
-	sched_info* sched = sched_get_context();
+	sched_info* sched = (sched_info*)userPointer;
 
-	sched->lastTimeUpdate = sched_clock_get_time();
+	sched->lastTimeUpdate = sched_clock_get_time(sched);
 	sched->startTime = sched->lastTimeUpdate;
 
 	while(true)
 	{
-		sched_fiber_info* fiber = 0;
+		sched_event_info* event = 0;
 		sched_action_info* action = 0;
 
-		switch(sched_pick_event(sched, &fiber, &action))
+		//NOTE(martin): the previous event may have moved the logical time past some staged actions
+		if(sched->actionSink == SCHED_ACTION_SINK_RING)
+		{
+			sched_action_ring_flush(sched);
+		}
+
+		switch(sched_pick_event(sched, &event, &action))
 		{
 			case SCHED_PICKED_ACTION:
 			{
 				sched->currentFiber = 0;
+				sched->eventCount++;
 
 				//TODO: correctly set logical loc / real time loc
 
@@ -1164,11 +2161,23 @@ i64 sched_run(void* userPointer)
 				sched_action_execute(sched, action);
 			} break;
 
-			case SCHED_PICKED_FIBER:
+			case SCHED_PICKED_EVENT:
 			{
+				sched->eventCount++;
+
+				if(event->kind == SCHED_EVENT_TIMER)
+				{
+					//NOTE(martin): we picked a timer, run its callback inline on the scheduler fiber
+					sched->currentFiber = 0;
+					sched_timer_execute(sched, ListEntry(event, sched_timer_info, event));
+					break;
+				}
+
 				//NOTE(martin): we picked a fiber, execute it
 				//NOTE(martin): if the fiber was suspended and is awaken after its timeout, clear its status flag,
 				//              set its wakeup code and remove it from the wait list its in.
+				sched_fiber_info* fiber = ListEntry(event, sched_fiber_info, event);
+
 				if(fiber->status == SCHED_STATUS_SUSPENDED)
 				{
 					fiber->status = SCHED_STATUS_ACTIVE;
@@ -1177,7 +2186,7 @@ i64 sched_run(void* userPointer)
 				}
 
 				//NOTE(martin): set the task loc and yield to fiber
-				fiber->task->logicalLoc = fiber->logicalLoc;
+				fiber->task->logicalLoc = fiber->event.logicalLoc;
 				sched->currentFiber = fiber;
 				fiber_yield(fiber->context);
 
@@ -1211,6 +2220,7 @@ sched_task_info* sched_task_alloc_init(sched_info* sched, sched_task_info* paren
 {
 	sched_task_info* task = mem_pool_alloc_type(&sched->taskPool, sched_task_info);
 	task->openHandles = 0;
+	task->selfHandle = (sched_task){.h = 0};
 	task->status = SCHED_STATUS_ACTIVE;
 
 	task->srcOffset = 0;
@@ -1233,7 +2243,10 @@ sched_task_info* sched_task_alloc_init(sched_info* sched, sched_task_info* paren
 	task->tempoCurve = 0; //sched_curve_create(task->descriptor.tempo);
 
 	//NOTE(martin): init fibers lists
-	ListInit(&task->fibers);
+	task->fiberCount = 0;
+	task->cancelActions = false;
+	ListInit(&task->pendingActions);
+	ListInit(&task->events);
 	ListInit(&task->suspended);
 	ListInit(&task->waiting);
 
@@ -1257,13 +2270,16 @@ sched_fiber_info* sched_fiber_alloc_init(sched_info* sched, sched_task_info* tas
 	sched_fiber_info* fiber = mem_pool_alloc_type(&sched->fiberPool, sched_fiber_info);
 	DEBUG_ASSERT(fiber);
 	fiber->openHandles = 0;
+	fiber->selfHandle = (sched_fiber){.h = 0};
 	fiber->status = SCHED_STATUS_ACTIVE;
 
 	fiber->task = task;
+	task->fiberCount++;
 	fiber->proc = proc;
 	fiber->userPointer = userPointer;
 
-	ListInit(&fiber->listElt);
+	fiber->event.kind = SCHED_EVENT_FIBER;
+	ListInit(&fiber->event.listElt);
 	ListInit(&fiber->jobQueueElt);
 	ListInit(&fiber->waiting);
 	ListInit(&fiber->waitingElt);
@@ -1279,7 +2295,7 @@ sched_fiber_info* sched_fiber_alloc_init(sched_info* sched, sched_task_info* tas
 sched_fiber_info* sched_fiber_create_with_task_ptr(sched_info* sched, sched_task_info* task, sched_fiber_proc proc, void* userPointer, sched_steps steps)
 {
 	sched_fiber_info* fiber = sched_fiber_alloc_init(sched, task, proc, userPointer);
-	sched_fiber_reschedule_in_steps(sched, fiber, 0);
+	sched_fiber_reschedule_in_steps(sched, fiber, steps);
 	return(fiber);
 }
 
@@ -1321,31 +2337,60 @@ sched_task sched_task_create_for_parent(sched_task parent, sched_fiber_proc proc
 	return(sched_task_create_for_parent_ptr(sched, parentPtr, proc, userPointer));
 }
 
+void sched_task_timescale_set_scaling_ptr(sched_info*, sched_task_info* task, f64 scaling)
+{
+	if(task->tempoCurve)
+	{
+		sched_curve_release(task->tempoCurve);
+		task->tempoCurve = 0;
+	}
+	task->descriptor.sync = SCHED_SYNC_SCALING;
+	task->descriptor.scaling = scaling;
+}
+
 void sched_task_timescale_set_scaling(sched_task task, f64 scaling)
 {
 	sched_info* sched = sched_get_context();
 	sched_task_info* taskPtr = sched_handle_get_task_ptr(sched, task);
-
-	if(taskPtr->tempoCurve)
+	sched_task_timescale_set_scaling_ptr(sched, taskPtr, scaling);
+}
+void sched_task_timescale_set_curve_ptr(sched_info* sched, sched_task_info* task, sched_curve* curve)
+{
+	//NOTE(martin): retain the new curve first, in case it is the same as the current one
+	sched_curve_retain(curve);
+	if(task->tempoCurve)
 	{
-		sched_curve_destroy(taskPtr->tempoCurve);
-		taskPtr->tempoCurve = 0;
+		sched_curve_release(task->tempoCurve);
 	}
-	taskPtr->descriptor.sync = SCHED_SYNC_SCALING;
-	taskPtr->descriptor.scaling = scaling;
+	task->descriptor.sync = SCHED_SYNC_CURVE;
+	task->tempoCurve = curve;
+	sched_curve_cursor_init(&task->tempoCursor);
+
+	task->tempoPrewarmTime = -INFINITY;
+	sched_task_prewarm_curve(sched, task);
+}
+
+void sched_task_timescale_set_curve(sched_task task, sched_curve* curve)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* taskPtr = sched_handle_get_task_ptr(sched, task);
+	DEBUG_ASSERT(curve);
+	sched_task_timescale_set_curve_ptr(sched, taskPtr, curve);
 }
+
 void sched_task_timescale_set_tempo_curve(sched_task task, sched_curve_descriptor* descriptor)
 {
 	sched_info* sched = sched_get_context();
 	sched_task_info* taskPtr = sched_handle_get_task_ptr(sched, task);
 
-	if(taskPtr->tempoCurve)
+	sched_curve* curve = sched_curve_create(descriptor);
+	if(!curve)
 	{
-		sched_curve_destroy(taskPtr->tempoCurve);
-		taskPtr->tempoCurve = 0;
+		LOG_ERROR("couldn't create tempo curve\n");
+		return;
 	}
-	taskPtr->descriptor.sync = SCHED_SYNC_CURVE;
-	taskPtr->tempoCurve = sched_curve_create(descriptor);
+	sched_task_timescale_set_curve_ptr(sched, taskPtr, curve);
+	sched_curve_release(curve);
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -1374,38 +2419,152 @@ sched_fiber sched_fiber_create(sched_fiber_proc proc, void* userPointer, sched_s
 	return(handle);
 }
 
-//------------------------------------------------------------------------------------------------------
-//NOTE(martin): scheduling / waits
-//------------------------------------------------------------------------------------------------------
-void sched_wait(sched_steps steps)
+f64 sched_fiber_desc_get_steps(const void* descs, u32 index)
+{
+	return(((const sched_fiber_desc*)descs)[index].steps);
+}
+
+void sched_fiber_create_batch(const sched_fiber_desc* descs, u32 count, sched_fiber* outHandles)
 {
-	//NOTE(martin): reschedule fiber
 	sched_info* sched = sched_get_context();
-	sched_fiber_info* fiber = sched->currentFiber;
+	DEBUG_ASSERT(sched->currentFiber);
+	sched_task_info* task = sched->currentFiber->task;
 
-	sched_fiber_reschedule_in_steps(sched, fiber, steps);
+	sched_batch_entry* entries = sched_batch_sort(sched, count, sched_fiber_desc_get_steps, descs);
 
-	//NOTE(martin): yield to the scheduler fiber
-	fiber_yield(fiber->context);
-}
+	//NOTE(martin): tickets follow submission order, as if the fibers had been created one by one
+	u64 firstTicket = sched->nextTicket;
+	sched->nextTicket += count;
 
-typedef enum { SCHED_WAIT_OK = 0,
-               SCHED_WAIT_INVALID_HANDLE,
-	       SCHED_WAIT_SIGNALED,
-	       SCHED_WAIT_TIMEOUT } sched_wait_code;
+	//NOTE(martin): merge fibers into the task's event list in a single pass. As in sched_event_schedule_at(),
+	//              new events go after existing events at the same location.
+	list_info* it = ListBegin(&task->events);
 
-sched_wait_code sched_fiber_put_on_object_waitlist_ptr(sched_info* sched,
-                                            sched_fiber_info* fiber,
-					    sched_object_handle handle,
-					    sched_object_signal signal,
+	for(u32 i=0; i<count; i++)
+	{
+		u32 index = entries[i].index;
+		const sched_fiber_desc* desc = &descs[index];
+
+		sched_fiber_info* fiber = sched_fiber_alloc_init(sched, task, desc->proc, desc->userPointer);
+		fiber->event.logicalLoc = task->logicalLoc + desc->steps;
+		fiber->event.ticket = firstTicket + index;
+
+		while(it != ListEnd(&task->events)
+		     && (ListEntry(it, sched_event_info, listElt)->logicalLoc - fiber->event.logicalLoc) <= 0)
+		{
+			it = it->next;
+		}
+		ListInsertBefore(it, &fiber->event.listElt);
+
+		if(outHandles)
+		{
+			outHandles[index] = sched_alloc_fiber_handle(sched, fiber);
+			fiber->openHandles = 1;
+		}
+	}
+	if(count)
+	{
+		task->status = SCHED_STATUS_ACTIVE;
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+//NOTE(martin): timers
+//------------------------------------------------------------------------------------------------------
+
+sched_timer sched_timer_create(sched_task task, sched_steps period, sched_timer_callback callback, void* userPointer)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* taskPtr = sched_handle_get_task_ptr(sched, task);
+	ASSERT(taskPtr);
+
+	if(period <= 0)
+	{
+		LOG_ERROR("timer period must be strictly positive\n");
+		return((sched_timer){.h = 0});
+	}
+	if(taskPtr->status == SCHED_STATUS_IDLE || taskPtr->status == SCHED_STATUS_COMPLETED)
+	{
+		LOG_ERROR("can't create a timer on a task that has no fibers left\n");
+		return((sched_timer){.h = 0});
+	}
+
+	sched_timer_info* timer = mem_pool_alloc_type(&sched->timerPool, sched_timer_info);
+	DEBUG_ASSERT(timer);
+
+	timer->event.kind = SCHED_EVENT_TIMER;
+	ListInit(&timer->event.listElt);
+	ListInit(&timer->waiting);
+	timer->status = SCHED_STATUS_ACTIVE;
+	timer->openHandles = 1;
+
+	timer->task = taskPtr;
+	timer->period = period;
+	timer->callback = callback;
+	timer->userPointer = userPointer;
+
+	//NOTE(martin): the first tick happens at the current location of the task
+	sched_event_schedule_at(sched, taskPtr, &timer->event, taskPtr->logicalLoc);
+
+	return(sched_alloc_timer_handle(sched, timer));
+}
+
+void sched_timer_cancel_ptr(sched_info* sched, sched_timer_info* timer)
+{
+	if(timer->status == SCHED_STATUS_COMPLETED)
+	{
+		return;
+	}
+	ListRemove(&timer->event.listElt);
+	timer->status = SCHED_STATUS_COMPLETED;
+
+	//NOTE(martin): notify all fibers waiting on this timer's completion
+	sched_signal_waiting_fibers(sched, &timer->waiting, SCHED_SIG_COMPLETED);
+
+	sched_timer_check_if_needs_recycling(sched, timer);
+}
+
+void sched_timer_cancel(sched_timer timer)
+{
+	sched_info* sched = sched_get_context();
+	sched_timer_info* timerPtr = sched_handle_get_timer_ptr(sched, timer);
+	ASSERT(timerPtr);
+
+	sched_timer_cancel_ptr(sched, timerPtr);
+}
+
+//------------------------------------------------------------------------------------------------------
+//NOTE(martin): scheduling / waits
+//------------------------------------------------------------------------------------------------------
+void sched_wait(sched_steps steps)
+{
+	//NOTE(martin): reschedule fiber
+	sched_info* sched = sched_get_context();
+	sched_fiber_info* fiber = sched->currentFiber;
+
+	sched_fiber_reschedule_in_steps(sched, fiber, steps);
+
+	//NOTE(martin): yield to the scheduler fiber
+	fiber_yield(fiber->context);
+}
+
+typedef enum { SCHED_WAIT_OK = 0,
+               SCHED_WAIT_INVALID_HANDLE,
+	       SCHED_WAIT_SIGNALED,
+	       SCHED_WAIT_TIMEOUT } sched_wait_code;
+
+sched_wait_code sched_fiber_put_on_object_waitlist_ptr(sched_info* sched,
+                                            sched_fiber_info* fiber,
+					    sched_object_handle handle,
+					    sched_object_signal signal,
 					    sched_steps timeout)
 {
 	//NOTE(martin): get the handle status and waiting list
-	sched_handle_slot* slot = 0;
+	sched_handle_lookup lookup;
 	list_info* waiting = 0;
 	sched_object_status status;
 
-	switch(sched_handle_slot_find_generic(sched, handle.h, &slot))
+	switch(sched_handle_slot_find_generic(sched, handle.h, &lookup))
 	{
 		case SCHED_HANDLE_INVALID:
 		case SCHED_HANDLE_FREE:
@@ -1413,20 +2572,30 @@ sched_wait_code sched_fiber_put_on_object_waitlist_ptr(sched_info* sched,
 
 		case SCHED_HANDLE_TASK:
 		{
-			status = slot->task->status;
-			waiting = &(slot->task->waiting);
+			status = lookup.task->status;
+			waiting = &(lookup.task->waiting);
 		} break;
 
 		case SCHED_HANDLE_FIBER:
 		{
-			status = slot->fiber->status;
-			waiting = &(slot->fiber->waiting);
+			status = lookup.fiber->status;
+			waiting = &(lookup.fiber->waiting);
 		} break;
+
+		case SCHED_HANDLE_TIMER:
+		{
+			status = lookup.timer->status;
+			waiting = &(lookup.timer->waiting);
+		} break;
+
+		case SCHED_HANDLE_ACTION:
+			//NOTE(martin): actions can't be waited on
+			return(SCHED_WAIT_INVALID_HANDLE);
 	}
 
 	//NOTE(martin): return immediately if the handle is already signaled
 	if(  (status == SCHED_STATUS_IDLE && signal == SCHED_SIG_IDLE)
-	  || ((status == SCHED_STATUS_COMPLETED) && (signal == SCHED_STATUS_IDLE || signal == SCHED_STATUS_COMPLETED )))
+	  || ((status == SCHED_STATUS_COMPLETED) && (signal == SCHED_SIG_IDLE || signal == SCHED_SIG_COMPLETED )))
 	{
 		return(SCHED_WAIT_SIGNALED);
 	}
@@ -1440,12 +2609,12 @@ sched_wait_code sched_fiber_put_on_object_waitlist_ptr(sched_info* sched,
 	else
 	{
 		ListRemove(&fiber->waitingElt);
-		ListRemove(&fiber->listElt);
+		ListRemove(&fiber->event.listElt);
 
 		if(timeout < 0)
 		{
-			fiber->logicalLoc = 0;
-			ListAppend(&fiber->task->suspended, &fiber->listElt);
+			fiber->event.logicalLoc = 0;
+			ListAppend(&fiber->task->suspended, &fiber->event.listElt);
 		}
 		else
 		{
@@ -1497,11 +2666,11 @@ sched_wakeup_code sched_wait_for_handle_generic(sched_object_handle handle, sche
 
 void sched_fiber_suspend_ptr(sched_info* sched, sched_fiber_info* fiber)
 {
-	ListRemove(&fiber->listElt);
+	ListRemove(&fiber->event.listElt);
 
 	fiber->status = SCHED_STATUS_SUSPENDED;
-	fiber->logicalLoc = 0;
-	ListAppend(&fiber->task->suspended, &fiber->listElt);
+	fiber->event.logicalLoc = 0;
+	ListAppend(&fiber->task->suspended, &fiber->event.listElt);
 
 	if(sched->currentFiber == fiber)
 	{
@@ -1523,15 +2692,20 @@ void sched_suspend()
 	sched_fiber_suspend_ptr(sched, sched->currentFiber);
 }
 
+void sched_fiber_resume_ptr(sched_info* sched, sched_fiber_info* fiber)
+{
+	fiber->status = SCHED_STATUS_ACTIVE;
+	ListRemove(&fiber->event.listElt);
+	sched_fiber_reschedule_in_steps(sched, fiber, 0);
+}
+
 void sched_fiber_resume(sched_fiber fiber)
 {
 	sched_info* sched = sched_get_context();
 	sched_fiber_info* fiberPtr = sched_handle_get_fiber_ptr(sched, fiber);
 	ASSERT(fiberPtr);
 
-	fiberPtr->status = SCHED_STATUS_ACTIVE;
-	ListRemove(&fiberPtr->listElt);
-	sched_fiber_reschedule_in_steps(sched, fiberPtr, 0);
+	sched_fiber_resume_ptr(sched, fiberPtr);
 }
 
 void sched_fiber_cancel_ptr(sched_info* sched, sched_fiber_info* fiber)
@@ -1539,7 +2713,7 @@ void sched_fiber_cancel_ptr(sched_info* sched, sched_fiber_info* fiber)
 	//NOTE(martin): remove the fiber from waiting lists and scheduling lists,
 	//              then complete the fiber
 	ListRemove(&fiber->waitingElt);
-	ListRemove(&fiber->listElt);
+	ListRemove(&fiber->event.listElt);
 
 	//NOTE(martin): notify waiting fibers of cancellation
 	sched_signal_waiting_fibers_on_cancel(sched, &fiber->waiting);
@@ -1558,8 +2732,24 @@ void sched_fiber_cancel(sched_fiber fiber)
 
 sched_task sched_task_self()
 {
+	//NOTE(martin): can be called from a fiber or from a timer callback. Action callbacks don't belong to any task.
 	sched_info* sched = sched_get_context();
-	return(sched_alloc_task_handle(sched, sched->currentFiber->task));
+	sched_task_info* task = sched_get_current_task(sched);
+	if(!task)
+	{
+		return((sched_task){.h = 0});
+	}
+	return(sched_get_task_self_handle(sched, task));
+}
+
+sched_fiber sched_fiber_self()
+{
+	sched_info* sched = sched_get_context();
+	if(!sched->currentFiber)
+	{
+		return((sched_fiber){.h = 0});
+	}
+	return(sched_get_fiber_self_handle(sched, sched->currentFiber));
 }
 
 void sched_task_suspend(sched_task task)
@@ -1598,11 +2788,21 @@ void sched_task_cancel_ptr(sched_info* sched, sched_task_info* task)
 	//NOTE(martin): notify waiting fibers of cancellation
 	sched_signal_waiting_fibers_on_cancel(sched, &task->waiting);
 
+	//NOTE(martin): cancel all timers of the task first, so that they're not removed from the event queue
+	//              while we iterate over it to cancel the fibers.
+	sched_task_cancel_timers(sched, task);
+
+	//NOTE(martin): cancel pending actions if the task asked for it
+	for_each_in_list_safe(&task->pendingActions, action, sched_action_info, taskElt)
+	{
+		sched_action_cancel_ptr(sched, action);
+	}
+
 	//NOTE(martin): cancel all fibers of the task. This will retire the task,
 	//              and complete it since it has no more children.
-	for_each_in_list_safe(&task->fibers, fiber, sched_fiber_info, listElt)
+	for_each_in_list_safe(&task->events, event, sched_event_info, listElt)
 	{
-		sched_fiber_cancel_ptr(sched, fiber);
+		sched_fiber_cancel_ptr(sched, ListEntry(event, sched_fiber_info, event));
 	}
 }
 
@@ -1623,8 +2823,8 @@ int sched_handle_get_exit_code_generic(sched_object_handle handle, i64* exitCode
 	sched_info* sched = sched_get_context();
 
 	//TODO(martin): return error if still active...
-	sched_handle_slot* slot = 0;
-	switch(sched_handle_slot_find_generic(sched, handle.h, &slot))
+	sched_handle_lookup lookup;
+	switch(sched_handle_slot_find_generic(sched, handle.h, &lookup))
 	{
 		case SCHED_HANDLE_INVALID:
 		case SCHED_HANDLE_FREE:
@@ -1632,13 +2832,21 @@ int sched_handle_get_exit_code_generic(sched_object_handle handle, i64* exitCode
 
 		case SCHED_HANDLE_TASK:
 		{
-			*exitCode = slot->task->exitCode;
+			*exitCode = lookup.task->exitCode;
 		} break;
 
 		case SCHED_HANDLE_FIBER:
 		{
-			*exitCode = slot->fiber->exitCode;
+			*exitCode = lookup.fiber->exitCode;
+		} break;
+
+		case SCHED_HANDLE_TIMER:
+		{
+			*exitCode = 0;
 		} break;
+
+		case SCHED_HANDLE_ACTION:
+			return(-1);
 	}
 	return(0);
 }
@@ -1646,8 +2854,16 @@ int sched_handle_get_exit_code_generic(sched_object_handle handle, i64* exitCode
 void sched_handle_release_generic(sched_object_handle handle)
 {
 	sched_info* sched = sched_get_context();
-	sched_handle_slot* slot = 0;
-	switch(sched_handle_slot_find_generic(sched, handle.h, &slot))
+	sched_handle_lookup lookup;
+	sched_handle_slot_kind kind = sched_handle_slot_find_generic(sched, handle.h, &lookup);
+
+	if(kind != SCHED_HANDLE_INVALID && lookup.borrowed)
+	{
+		//NOTE(martin): borrowed handles are owned by their object
+		return;
+	}
+
+	switch(kind)
 	{
 		case SCHED_HANDLE_INVALID:
 		case SCHED_HANDLE_FREE:
@@ -1655,20 +2871,31 @@ void sched_handle_release_generic(sched_object_handle handle)
 
 		case SCHED_HANDLE_TASK:
 		{
-			sched_task_info* task = slot->task;
+			sched_task_info* task = lookup.task;
 			task->openHandles--;
 			sched_task_check_if_needs_recycling(sched, task);
 		} break;
 
 		case SCHED_HANDLE_FIBER:
 		{
-			sched_fiber_info* fiber = slot->fiber;
+			sched_fiber_info* fiber = lookup.fiber;
 			fiber->openHandles--;
 			sched_fiber_check_if_needs_recycling(sched, fiber);
 		} break;
+
+		case SCHED_HANDLE_TIMER:
+		{
+			sched_timer_info* timer = lookup.timer;
+			timer->openHandles--;
+			sched_timer_check_if_needs_recycling(sched, timer);
+		} break;
+
+		case SCHED_HANDLE_ACTION:
+			//NOTE(martin): unreachable, action handles are always borrowed
+			break;
 	}
 	//NOTE(martin): recycle the handle slot
-	sched_handle_slot_recycle(sched, slot);
+	sched_handle_slot_recycle(sched, lookup.slot);
 }
 
 /*
@@ -1689,13 +2916,13 @@ void sched_background()
 	sched_info* sched = sched_get_context();
 	sched_fiber_info* fiber = sched->currentFiber;
 
-	DEBUG_ASSERT(ListEmpty(&fiber->listElt), "fiber should have been removed from its task's list by sched_pick_event()");
+	DEBUG_ASSERT(ListEmpty(&fiber->event.listElt), "fiber should have been removed from its task's list by sched_pick_event()");
 	DEBUG_ASSERT(ListEmpty(&fiber->waitingElt), "fiber is executing, so it should have been removed from any waiting list");
 
 	//NOTE(martin): set the fiber status to background, put it at the end of the task's fibers list, and yield.
 	//              The scheduler thread will notice the background status and put the fiber on the background jobs queue.
-	fiber->logicalLoc = 0;
-	ListAppend(&fiber->task->suspended, &fiber->listElt);
+	fiber->event.logicalLoc = 0;
+	ListAppend(&fiber->task->suspended, &fiber->event.listElt);
 	fiber->status = SCHED_STATUS_BACKGROUND;
 	fiber_yield(fiber->context);
 }
@@ -1707,6 +2934,51 @@ void sched_foreground()
 	fiber_yield(__backgroundJobCurrentFiber->context);
 }
 
+//------------------------------------------------------------------------------------------------------
+//NOTE(martin): offline rendering
+//------------------------------------------------------------------------------------------------------
+
+sched_render_stats sched_render_until(f64 seconds)
+{
+	sched_info* sched = sched_get_context();
+	sched_render_stats stats = {};
+
+	if(sched->clockMode != SCHED_CLOCK_OFFLINE)
+	{
+		LOG_ERROR("sched_render_until() can only be used with an offline scheduler\n");
+		return(stats);
+	}
+	DEBUG_ASSERT(sched->currentFiber, "sched_render_until() must be called from a fiber");
+	DEBUG_ASSERT(!sched->renderFiber, "only one fiber can call sched_render_until() at a time");
+
+	f64 startClock = sched->offlineClock;
+	u64 startEventCount = sched->eventCount;
+	f64 startWallClock = ClockGetTime(SYS_CLOCK_MONOTONIC);
+
+	//NOTE(martin): suspend the calling fiber until the virtual clock reaches the deadline.
+	//              It will be woken up by a SCHED_MESSAGE_RENDER_DEADLINE message posted by sched_offline_advance_clock()
+	f64 deadline = sched->startTime + seconds;
+	if(deadline > sched->offlineClock)
+	{
+		sched->renderFiber = sched->currentFiber;
+		sched->renderDeadline = deadline;
+		sched_fiber_suspend_ptr(sched, sched->currentFiber);
+	}
+
+	stats.renderedTime = sched->offlineClock - startClock;
+	stats.wallClockTime = ClockGetTime(SYS_CLOCK_MONOTONIC) - startWallClock;
+	stats.eventCount = sched->eventCount - startEventCount;
+	stats.eventsPerSecond = (stats.wallClockTime > 0) ? stats.eventCount / stats.wallClockTime : 0;
+
+	LOG_MESSAGE("rendered %fs in %fs (%llu events, %f events/s)\n",
+	            stats.renderedTime,
+	            stats.wallClockTime,
+	            (unsigned long long)stats.eventCount,
+	            stats.eventsPerSecond);
+
+	return(stats);
+}
+
 //------------------------------------------------------------------------------------------------------
 //NOTE(martin): actions functions
 //------------------------------------------------------------------------------------------------------
@@ -1714,41 +2986,245 @@ void sched_foreground()
 void sched_action(sched_action_callback callback, u32 size, char* data)
 {
 	sched_info* sched = sched_get_context();
-	sched_action_info* action = mem_pool_alloc_type(&sched->actionPool, sched_action_info);
+	sched_action_emit(sched, sched_get_current_task(sched), callback, size, data, 0, sched->lookAhead);
+}
 
-	action->callback = callback;
+void sched_action_no_copy(sched_action_callback callback, void* userPointer)
+{
+	sched_info* sched = sched_get_context();
+	sched_action_emit(sched, sched_get_current_task(sched), callback, 0, 0, userPointer, sched->lookAhead);
+}
+
+void sched_action_in(sched_steps steps, sched_action_callback callback, u32 size, char* data)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* task = sched_get_current_task(sched);
+	DEBUG_ASSERT(task, "future-dated actions must be emitted from a fiber or a timer");
+	f64 delay = maximum(0., sched_action_delay_from_steps(sched, task, steps));
+	sched_action_emit(sched, task, callback, size, data, 0, delay);
+}
+
+void sched_action_no_copy_in(sched_steps steps, sched_action_callback callback, void* userPointer)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* task = sched_get_current_task(sched);
+	DEBUG_ASSERT(task, "future-dated actions must be emitted from a fiber or a timer");
+	f64 delay = maximum(0., sched_action_delay_from_steps(sched, task, steps));
+	sched_action_emit(sched, task, callback, 0, 0, userPointer, delay);
+}
+
+sched_action_handle sched_action_create(sched_steps steps, sched_action_callback callback, u32 size, char* data)
+{
+	sched_info* sched = sched_get_context();
+	sched_task_info* task = sched_get_current_task(sched);
+	DEBUG_ASSERT(task, "future-dated actions must be emitted from a fiber or a timer");
+	f64 delay = maximum(0., sched_action_delay_from_steps(sched, task, steps));
 
-	if(size <= SCHED_ACTION_INFO_SBO_SIZE)
+	sched_action_info* action = sched_action_emit(sched, task, callback, size, data, 0, delay);
+	if(!action)
 	{
-		action->userPointer = &action->sbo;
-		action->allocatedData = false;
+		//NOTE(martin): actions sent to the output ring or dropped can't be cancelled
+		return((sched_action_handle){.h = 0});
 	}
-	else
+	sched_action_handle handle = sched_alloc_action_handle(sched, action);
+	action->handle = handle.h;
+	return(handle);
+}
+
+void sched_action_cancel(sched_action_handle action)
+{
+	//NOTE(martin): action handles become invalid once the action has fired, so cancelling a stale handle is a no-op
+	sched_info* sched = sched_get_context();
+	sched_handle_lookup lookup;
+	if(sched_handle_slot_find_generic(sched, action.h, &lookup) == SCHED_HANDLE_ACTION)
 	{
-		action->userPointer = (void*)malloc(size);
-		action->allocatedData = true;
+		sched_action_cancel_ptr(sched, lookup.action);
 	}
-	memcpy(action->userPointer, data, size);
+}
 
-	sched_action_schedule(sched, action);
+f64 sched_action_desc_get_steps(const void* descs, u32 index)
+{
+	return(((const sched_action_desc*)descs)[index].steps);
 }
 
-void sched_action_no_copy(sched_action_callback callback, void* userPointer)
+void sched_action_batch(const sched_action_desc* descs, u32 count)
 {
 	sched_info* sched = sched_get_context();
-	sched_action_info* action = mem_pool_alloc_type(&sched->actionPool, sched_action_info);
+	sched_task_info* task = sched_get_current_task(sched);
+	DEBUG_ASSERT(task, "action batches must be emitted from a fiber or a timer");
 
-	action->callback = callback;
-	action->userPointer = userPointer;
-	action->allocatedData = false;
+	sched_batch_entry* entries = sched_batch_sort(sched, count, sched_action_desc_get_steps, descs);
+
+	//NOTE(martin): convert steps to delays. Delays are increasing since they are converted through the same timescale
+	//              and we reuse the sort keys to hold them.
+	for(u32 i=0; i<count; i++)
+	{
+		entries[i].key = sched_action_delay_from_steps(sched, task, entries[i].key);
+	}
+
+	if(sched->actionSink == SCHED_ACTION_SINK_RING)
+	{
+		sched_action_ring_flush(sched);
+	}
+
+	//NOTE(martin): merge actions into the action list in a single pass. As in sched_action_schedule(), new actions
+	//              go after existing actions with the same delay. In ring mode, entries that are due by the current
+	//              logical time are pushed to the ring in order, and the others are staged.
+	list_info* it = ListBegin(&sched->actions);
+	f64 cumulatedDelay = 0;
+
+	for(u32 i=0; i<count; i++)
+	{
+		const sched_action_desc* desc = &descs[entries[i].index];
+		f64 delayFromNow = entries[i].key;
+
+		if(desc->size > SCHED_ACTION_PAYLOAD_MAX_SIZE)
+		{
+			LOG_ERROR("action payload too big (%u bytes, max is %u)\n", desc->size, SCHED_ACTION_PAYLOAD_MAX_SIZE);
+			continue;
+		}
+		if(sched->actionSink == SCHED_ACTION_SINK_RING && delayFromNow <= sched->lookAhead)
+		{
+			sched_action_ring_emit(sched, sched->lastTimeUpdate + delayFromNow, desc->callback, desc->size, desc->data, desc->data);
+			continue;
+		}
+
+		sched_action_info* action = sched_action_alloc(sched, task, desc->callback, desc->size, desc->data, desc->data);
+		if(sched->actionSink == SCHED_ACTION_SINK_RING)
+		{
+			action->staged = true;
+			action->time = sched->lastTimeUpdate + delayFromNow;
+		}
+
+		while(it != ListEnd(&sched->actions))
+		{
+			sched_action_info* item = ListEntry(it, sched_action_info, listElt);
+			if(cumulatedDelay + item->delay > delayFromNow)
+			{
+				//NOTE(martin): item's delay becomes relative to the new action
+				item->delay = cumulatedDelay + item->delay - delayFromNow;
+				break;
+			}
+			cumulatedDelay += item->delay;
+			it = it->next;
+		}
+		action->delay = delayFromNow - cumulatedDelay;
+		ListInsertBefore(it, &action->listElt);
+		cumulatedDelay = delayFromNow;
+	}
+}
+
+u32 sched_action_ring_drain(sched_context* context, f64 blockTime, f64 sampleRate, u32 frameCount, sched_action_ring_handler handler, void* userPointer)
+{
+	//NOTE(martin): this is called by the consumer thread, so we only touch the ring and never the rest of the scheduler
+	sched_info* sched = context ? context : sched_get_context();
+	sched_action_ring* ring = &sched->actionRing;
+	if(!ring->buffer)
+	{
+		return(0);
+	}
+
+	f64 blockEnd = blockTime + frameCount / sampleRate;
+	u64 writeIndex = ring->writeIndex;
+	u64 index = ring->readIndex;
+	bool release = true;
+	u32 count = 0;
+
+	while(index < writeIndex)
+	{
+		u64 offset = index & (ring->capacity - 1);
+		u64 recordSize = ring->capacity - offset;
+		if(recordSize >= sizeof(sched_action_ring_header))
+		{
+			sched_action_ring_header* header = (sched_action_ring_header*)(ring->buffer + offset);
+			recordSize = header->recordSize;
+
+			if(header->callback && header->time < blockEnd)
+			{
+				sched_action_record record = {.time = header->time,
+				                              .sampleOffset = 0,
+				                              .callback = header->callback,
+				                              .userPointer = header->dataSize ? (void*)(header+1) : header->userPointer};
 
-	sched_action_schedule(sched, action);
+				//NOTE(martin): late records are played at the start of the block
+				if(header->time > blockTime)
+				{
+					record.sampleOffset = minimum((u32)((header->time - blockTime) * sampleRate), frameCount - 1);
+				}
+
+				if(handler)
+				{
+					handler(&record, userPointer);
+				}
+				else
+				{
+					record.callback(record.userPointer);
+				}
+				count++;
+
+				//NOTE(martin): mark the record as drained. The producer doesn't write it until we release it.
+				header->callback = 0;
+			}
+			else if(header->callback)
+			{
+				//NOTE(martin): the record falls after this block. Skip it, but keep it and the records after it in
+				//              the ring until it is drained.
+				release = false;
+			}
+		}
+		index += recordSize;
+
+		if(release)
+		{
+			//NOTE(martin): release the drained records to the producer
+			ring->readIndex = index;
+		}
+	}
+	return(count);
+}
+
+//------------------------------------------------------------------------------------------------------
+//NOTE(martin): scheduler contexts
+//------------------------------------------------------------------------------------------------------
+sched_context* sched_context_create()
+{
+	sched_info* sched = malloc_type(sched_info);
+	//NOTE(martin): zeroed like in sched_end(), see the note there
+	memset((void*)sched, 0, sizeof(sched_info));
+	return(sched);
+}
+
+void sched_context_destroy(sched_context* context)
+{
+	//NOTE(martin): a running context still has background threads and fibers that point to it, and sched_end() must
+	//              be called from the context's main fiber, so we can't end it here.
+	DEBUG_ASSERT(!context->initialized, "sched_end() must be called before destroying a scheduler context");
+	if(context->initialized)
+	{
+		LOG_ERROR("can't destroy a scheduler context that is still running, call sched_end() first\n");
+		return;
+	}
+	if(__schedCurrentContext == context)
+	{
+		__schedCurrentContext = 0;
+	}
+	free(context);
+}
+
+void sched_context_set_current(sched_context* context)
+{
+	__schedCurrentContext = context;
+}
+
+sched_context* sched_context_get_current()
+{
+	return(sched_get_context());
 }
 
 //------------------------------------------------------------------------------------------------------
 //NOTE(martin): sched init / end functions
 //------------------------------------------------------------------------------------------------------
-void sched_init()
+void sched_init_with_options(sched_init_options* options)
 {
 	sched_info* sched = sched_get_context();
 
@@ -1758,10 +3234,11 @@ void sched_init()
 	mem_pool_init(&sched->taskPool, sizeof(sched_task_info));
 	mem_pool_init(&sched->stackPool, SCHED_FIBER_STACK_SIZE);
 	mem_pool_init(&sched->actionPool, sizeof(sched_action_info));
+	mem_pool_init(&sched->timerPool, sizeof(sched_timer_info));
+	sched_action_payload_pools_init(sched);
 
 	//NOTE(martin): init handle map
-	sched->nextHandleSlot = 0;
-	ListInit(&sched->handleFreeList);
+	sched_handle_table_init(&sched->handles);
 
 	//NOTE(martin): init command locks
 	sched->msgCondition = ConditionCreate();
@@ -1780,10 +3257,26 @@ void sched_init()
 	sched->lookAhead = 0;
 	sched->lookAheadWindow = 10e-3; // set default lookAheadWindow to 10ms.
 
+	sched->clockMode = options->clock;
+	sched->offlineClock = 0;
+	sched->backgroundJobCount = 0;
+	sched->renderFiber = 0;
+	sched->renderDeadline = 0;
+	sched->eventCount = 0;
+
+	sched->initialized = true;
+
+	sched->actionSink = options->actionSink;
+	if(sched->actionSink == SCHED_ACTION_SINK_RING)
+	{
+		sched_action_ring_init(&sched->actionRing, options->actionRingSize ? options->actionRingSize : SCHED_ACTION_RING_DEFAULT_SIZE);
+	}
+
 	ListInit(&sched->actions);
 	ListInit(&sched->runningTasks);
 	ListInit(&sched->suspendedTasks);
 	sched->currentFiber = 0;
+	sched->currentTimer = 0;
 
 	//NOTE(martin): init job queue
 	sched_background_queue_init(sched);
@@ -1793,7 +3286,7 @@ void sched_init()
 	//              will contain the entry point to the main fiber.
 
 	sched_task_info* task = sched_task_alloc_init(sched, 0);
-	sched_fiber_info* fiber = sched_fiber_alloc_init(sched, task, sched_run, 0);
+	sched_fiber_info* fiber = sched_fiber_alloc_init(sched, task, sched_run, sched);
 	task->mainFiber = fiber;
 
 	//NOTE(martin): put the task in the running list, and set the current fiber, so that we're in the same state as if we just
@@ -1805,6 +3298,15 @@ void sched_init()
 	sched_wait(0);
 }
 
+void sched_init()
+{
+	sched_init_options options = {};
+	#ifdef SCHED_OFFLINE
+		options.clock = SCHED_CLOCK_OFFLINE;
+	#endif
+	sched_init_with_options(&options);
+}
+
 void sched_end()
 {
 	sched_info* sched = sched_get_context();
@@ -1824,43 +3326,176 @@ void sched_end()
 		sched_task_cancel_ptr(sched, task);
 	}
 
-	//NOTE(martin): release action memory
+	//NOTE(martin): drop the messages that weren't dispatched, and the deferred commands, releasing the curve
+	//              references they hold
+	sched_message* message = 0;
+	while((message = sched_next_message(sched, message)) != 0)
+	{
+		sched_command_release(message);
+	}
+
 	for_each_in_list(&sched->actions, action, sched_action_info, listElt)
 	{
-		if(action->allocatedData)
+		if(action->callback == sched_command_execute_deferred)
 		{
-			free(action->userPointer);
+			sched_command_release((sched_message*)action->userPointer);
 		}
 	}
 
 	//NOTE(martin): release memory from all pools
+	mem_pool_release(&sched->messagePool);
 	mem_pool_release(&sched->actionPool);
+	sched_action_payload_pools_release(sched);
+	mem_pool_release(&sched->timerPool);
 	mem_pool_release(&sched->fiberPool);
 	mem_pool_release(&sched->taskPool);
 	mem_pool_release(&sched->stackPool);
 
+	//NOTE(martin): release handle table and action ring
+	sched_handle_table_release(&sched->handles);
+	sched_action_ring_release(&sched->actionRing);
+	free(sched->batchScratch);
+
 	//NOTE(martin): destroy command locks
 	ConditionDestroy(sched->msgCondition);
 	MutexDestroy(sched->msgConditionMutex);
 
-	//NOTE(martin): clear context
-	memset(sched, 0, sizeof(sched_info));
+	//NOTE(martin): clear context, so that it can be initialized again. No other thread touches the context at this
+	//              point, and the atomics it holds are lock-free integers and pointers whose zero value is all zero
+	//              bytes, so we clear them along with the rest of the struct.
+	memset((void*)sched, 0, sizeof(sched_info));
+}
+
+
+//------------------------------------------------------------------------------------------------------
+//NOTE(martin): commands posted from other threads
+//------------------------------------------------------------------------------------------------------
+
+typedef struct sched_post_batch
+{
+	bool active;
+	sched_info* sched;
+	list_info messages;
+
+} sched_post_batch;
+
+_Thread_local sched_post_batch __schedPostBatch = {};
+
+void sched_post_batch_begin()
+{
+	DEBUG_ASSERT(!__schedPostBatch.active, "nested post batches are not supported");
+	__schedPostBatch.active = true;
+	__schedPostBatch.sched = sched_get_context();
+	ListInit(&__schedPostBatch.messages);
+}
+
+void sched_post_batch_end()
+{
+	DEBUG_ASSERT(__schedPostBatch.active);
+	__schedPostBatch.active = false;
+
+	sched_info* sched = __schedPostBatch.sched;
+	if(ListEmpty(&__schedPostBatch.messages))
+	{
+		return;
+	}
+
+	//NOTE(martin): commit the whole batch with a single lock and a single signal
+	MutexLock(sched->msgConditionMutex);
+	{
+		TicketSpinMutexLock(&sched->msgQueueMutex);
+		{
+			ListCat(&sched->messages, &__schedPostBatch.messages);
+			sched->hasMessages = true;
+		} TicketSpinMutexUnlock(&sched->msgQueueMutex);
+
+		ConditionSignal(sched->msgCondition);
+	} MutexUnlock(sched->msgConditionMutex);
 }
 
+void sched_post_message(sched_info* sched, sched_message* message)
+{
+	if(__schedPostBatch.active)
+	{
+		DEBUG_ASSERT(__schedPostBatch.sched == sched);
+		ListAppend(&__schedPostBatch.messages, &message->listElt);
+	}
+	else
+	{
+		sched_message_commit(sched, message);
+	}
+}
 
-//////////////////////////// WIP ////////////////////////////////////
+void sched_post_action(sched_action_callback callback, u32 size, char* data, f64 timestamp)
+{
+	if(size > SCHED_MESSAGE_PAYLOAD_SIZE)
+	{
+		LOG_ERROR("posted action payload too big (%u bytes, max is %u)\n", size, SCHED_MESSAGE_PAYLOAD_SIZE);
+		return;
+	}
+	sched_info* sched = sched_get_context();
+
+	sched_message* message = sched_message_acquire(sched);
+	{
+		message->kind = SCHED_MESSAGE_ACTION;
+		message->timestamp = timestamp;
+		message->action.callback = callback;
+		message->action.size = size;
+		memcpy(message->action.data, data, size);
+	} sched_post_message(sched, message);
+}
 
-void sched_command_fiber_wakeup(sched_fiber fiber)
+void sched_post_fiber_wakeup(sched_fiber fiber, f64 timestamp)
 {
 	sched_info* sched = sched_get_context();
 
 	sched_message* message = sched_message_acquire(sched);
 	{
 		message->kind = SCHED_MESSAGE_WAKEUP;
+		message->timestamp = timestamp;
 		message->fiberHandle = fiber;
-	} sched_message_commit(sched, message);
+	} sched_post_message(sched, message);
 }
 
+void sched_post_fiber_create(sched_task task, sched_fiber_proc proc, void* userPointer, f64 timestamp)
+{
+	sched_info* sched = sched_get_context();
+
+	sched_message* message = sched_message_acquire(sched);
+	{
+		message->kind = SCHED_MESSAGE_FIBER_CREATE;
+		message->timestamp = timestamp;
+		message->fiberCreate.task = task;
+		message->fiberCreate.proc = proc;
+		message->fiberCreate.userPointer = userPointer;
+	} sched_post_message(sched, message);
+}
 
+void sched_post_task_set_scaling(sched_task task, f64 scaling, f64 timestamp)
+{
+	sched_info* sched = sched_get_context();
+
+	sched_message* message = sched_message_acquire(sched);
+	{
+		message->kind = SCHED_MESSAGE_TASK_SET_SCALING;
+		message->timestamp = timestamp;
+		message->taskScaling.task = task;
+		message->taskScaling.scaling = scaling;
+	} sched_post_message(sched, message);
+}
+
+void sched_post_task_set_curve(sched_task task, sched_curve* curve, f64 timestamp)
+{
+	sched_info* sched = sched_get_context();
+	DEBUG_ASSERT(curve);
+
+	sched_message* message = sched_message_acquire(sched);
+	{
+		message->kind = SCHED_MESSAGE_TASK_SET_CURVE;
+		message->timestamp = timestamp;
+		message->taskCurve.task = task;
+		message->taskCurve.curve = sched_curve_retain(curve);
+	} sched_post_message(sched, message);
+}
 
 #undef LOG_SUBSYSTEM
@@ -20,10 +20,15 @@ typedef f64 sched_steps;
 
 typedef i64(*sched_fiber_proc)(void* userPointer);
 typedef void(*sched_action_callback)(void* userPointer);
+typedef void(*sched_timer_callback)(void* userPointer);
 
 typedef struct sched_object_handle { u64 h; } sched_object_handle;
 typedef struct sched_task { u64 h; } sched_task;
 typedef struct sched_fiber { u64 h; } sched_fiber;
+typedef struct sched_timer { u64 h; } sched_timer;
+typedef struct sched_action_handle { u64 h; } sched_action_handle;
+
+typedef struct sched_info sched_context;
 
 #define sched_generic_handle(handle) (sched_object_handle){.h = (handle).h}
 
@@ -31,6 +36,57 @@ typedef u64 sched_object_signal;
 const sched_object_signal SCHED_SIG_IDLE   = 0x01,
                           SCHED_SIG_COMPLETED = 0x01<<1;
 
+typedef enum { SCHED_CLOCK_REALTIME = 0,
+               SCHED_CLOCK_OFFLINE } sched_clock_mode;
+
+typedef enum { SCHED_ACTION_SINK_EXECUTE = 0, // actions are executed on the scheduler thread at their due time
+               SCHED_ACTION_SINK_RING } sched_action_sink; // actions are written to the output ring when emitted
+
+typedef struct sched_init_options
+{
+	sched_clock_mode clock;
+	sched_action_sink actionSink;
+	u32 actionRingSize; // in bytes, for SCHED_ACTION_SINK_RING. 0 selects a default of 64KB
+
+} sched_init_options;
+
+typedef struct sched_action_record
+{
+	f64 time;          // target time, on the scheduler's clock
+	u32 sampleOffset;  // offset of the target time in the block being drained
+	sched_action_callback callback;
+	void* userPointer; // payload. Only valid until the handler returns
+
+} sched_action_record;
+
+typedef void(*sched_action_ring_handler)(sched_action_record* record, void* userPointer);
+
+typedef struct sched_action_desc
+{
+	sched_steps steps; // offset from the current logical time, in the current task's steps
+	sched_action_callback callback;
+	u32 size;          // size of the payload to copy (up to 64KB), or 0 to pass data as is
+	char* data;
+
+} sched_action_desc;
+
+typedef struct sched_fiber_desc
+{
+	sched_fiber_proc proc;
+	void* userPointer;
+	sched_steps steps;
+
+} sched_fiber_desc;
+
+typedef struct sched_render_stats
+{
+	f64 renderedTime;  // virtual time rendered, in seconds
+	f64 wallClockTime; // real time it took, in seconds
+	u64 eventCount;    // number of fibers, timers and actions executed
+	f64 eventsPerSecond;
+
+} sched_render_stats;
+
 typedef enum { SCHED_WAKEUP_INVALID_HANDLE,
                SCHED_WAKEUP_HANDLE_ERROR,
 	       SCHED_WAKEUP_TIMEOUT,
@@ -41,34 +97,67 @@ typedef enum { SCHED_WAKEUP_INVALID_HANDLE,
 // Scheduler API
 //---------------------------------------------------------------
 
+//NOTE: scheduler contexts. Each context is an independent scheduler with its own tasks, handles, background threads and clock.
+//      The API functions below operate on the context bound to the calling thread by sched_context_set_current(), or
+//      on a default context if the thread didn't bind any. A context must be ended with sched_end() before it is destroyed.
+sched_context* sched_context_create();
+void sched_context_destroy(sched_context* context);
+void sched_context_set_current(sched_context* context);
+sched_context* sched_context_get_current();
+
 //NOTE: start / end the scheduler. This will create a first task for the calling function
 void sched_init();
+void sched_init_with_options(sched_init_options* options);
 void sched_end();
 
+//NOTE: offline rendering. With a SCHED_CLOCK_OFFLINE clock, the scheduler doesn't sleep but jumps directly to the next
+//      event, and waits for background jobs to complete before advancing time. sched_render_until() runs the scheduler
+//      until the given time (in seconds since sched_init()) and returns the rendering statistics.
+sched_render_stats sched_render_until(f64 seconds);
+
 //NOTE: tasks
 sched_task sched_task_create(sched_fiber_proc proc, void* userPointer);
 sched_task sched_task_create_detached(sched_fiber_proc proc, void* userPointer);
 sched_task sched_task_create_for_parent(sched_task parent, sched_fiber_proc proc, void* userPointer);
 //TODO: sched_task_create_shared()
 
+//NOTE: sched_task_self() and sched_fiber_self() return a borrowed handle, which stays valid as long as the object isn't
+//      recycled. It is cached, so repeated calls don't allocate. Releasing a borrowed handle has no effect.
+//      They return a null handle when called outside of a fiber (or, for sched_task_self(), a timer callback).
 sched_task sched_task_self();
 void sched_task_cancel(sched_task task);
 void sched_task_suspend(sched_task task);
 void sched_task_resume(sched_task task);
 
 //NOTE: task's timescales
+//NOTE(martin): when set, actions emitted by the task that are still pending are cancelled when the task is cancelled
+void sched_task_set_cancel_actions(sched_task task, bool cancelActions);
+
 void sched_task_timescale_set_scaling(sched_task task, f64 scaling);
 void sched_task_timescale_set_tempo_curve(sched_task task, sched_curve_descriptor* descriptor);
 
+//NOTE(martin): attach a shared curve to a task. The task retains the curve, so the caller keeps its own reference.
+void sched_task_timescale_set_curve(sched_task task, sched_curve* curve);
+
 //NOTE(martin): fibers
 sched_fiber sched_fiber_create(sched_fiber_proc proc, void* userPointer, sched_steps steps);
 sched_fiber sched_fiber_create_for_task(sched_task task, sched_fiber_proc proc, void* userPointer, sched_steps steps);
 
+//NOTE(martin): creates count fibers in the current task with a single sorted merge. If outHandles is not null, it receives
+//              a handle for each descriptor. Otherwise the fibers are recycled as soon as they complete.
+void sched_fiber_create_batch(const sched_fiber_desc* descs, u32 count, sched_fiber* outHandles);
+
 sched_fiber sched_fiber_self();
 void sched_fiber_cancel(sched_fiber fiber);
 void sched_fiber_suspend(sched_fiber fiber);
 void sched_fiber_resume(sched_fiber fiber);
 
+//NOTE(martin): periodic timers. The callback is called every period steps of the task's timescale, starting at the task's
+//              current location. It runs directly on the scheduler fiber, so it must not call any blocking or waiting function.
+//              Timers are cancelled when their task runs out of fibers.
+sched_timer sched_timer_create(sched_task task, sched_steps period, sched_timer_callback callback, void* userPointer);
+void sched_timer_cancel(sched_timer timer);
+
 //NOTE(martin): fiber self scheduling
 void sched_cancel();
 void sched_suspend();
@@ -88,24 +177,79 @@ sched_object_handle sched_handle_duplicate_generic(sched_object_handle handle);
 #define sched_handle_get_exit_code(handle, exitCode) _Generic((handle), \
                                                               sched_object_handle: sched_handle_get_exit_code_generic, \
                                                               sched_task: sched_handle_get_exit_code_generic, \
-				                              sched_fiber: sched_handle_get_exit_code_generic)(sched_generic_handle(handle), exitCode)
+				                              sched_fiber: sched_handle_get_exit_code_generic, \
+				                              sched_timer: sched_handle_get_exit_code_generic, \
+				                              sched_action_handle: sched_handle_get_exit_code_generic)(sched_generic_handle(handle), exitCode)
 
 #define sched_handle_release(handle) _Generic((handle), \
                                               sched_object_handle: sched_handle_release_generic, \
                                               sched_task: sched_handle_release_generic, \
-				              sched_fiber: sched_handle_release_generic)(sched_generic_handle(handle))
+				              sched_fiber: sched_handle_release_generic, \
+				              sched_timer: sched_handle_release_generic, \
+				              sched_action_handle: sched_handle_release_generic)(sched_generic_handle(handle))
 
 #define sched_handle_duplicate(handle) _Generic((handle), \
 					      sched_object_handle: sched_handle_duplicate_generic, \
                                               sched_task: sched_handle_duplicate_generic, \
-				              sched_fiber: sched_handle_duplicate_generic)(sched_generic_handle(handle))
+				              sched_fiber: sched_handle_duplicate_generic, \
+				              sched_timer: sched_handle_duplicate_generic, \
+				              sched_action_handle: sched_handle_duplicate_generic)(sched_generic_handle(handle))
 
 //NOTE(martin): background jobs
 void sched_background();
 void sched_foreground();
 
-//NOTE(martin): buffered actions
+//NOTE(martin): buffered actions. Payloads are copied, and are limited to 64KB. Bigger payloads must use the no-copy
+//              variants.
 void sched_action(sched_action_callback callback, u32 size, char* data);
 void sched_action_no_copy(sched_action_callback callback, void* userPointer);
 
+//NOTE(martin): future-dated actions. steps is an offset from the current logical time in the current task's steps, and is
+//              converted through the task's timescale chain, so a fiber can emit a whole pattern in a single wakeup.
+//              Note that the conversion uses the tempo known at emission time.
+void sched_action_in(sched_steps steps, sched_action_callback callback, u32 size, char* data);
+void sched_action_no_copy_in(sched_steps steps, sched_action_callback callback, void* userPointer);
+
+//NOTE(martin): cancellable actions. sched_action_create() works like sched_action_in() but returns a handle that can be
+//              passed to sched_action_cancel() until the action fires. The handle is owned by the action and doesn't need
+//              to be released. In ring mode, actions that are pushed to the output ring right away can't be cancelled
+//              and get a null handle.
+sched_action_handle sched_action_create(sched_steps steps, sched_action_callback callback, u32 size, char* data);
+void sched_action_cancel(sched_action_handle action);
+
+//NOTE(martin): emits count actions, sorted once and merged into the action queue in a single pass.
+void sched_action_batch(const sched_action_desc* descs, u32 count);
+
+//NOTE(martin): in SCHED_ACTION_SINK_RING mode, actions are not executed by the scheduler but pushed to a lock-free single
+//              producer/single consumer ring once the scheduler's logical time reaches them, ie. lookAhead ahead of
+//              their target time. Future-dated actions are staged in the action queue until then, so that the ring
+//              only holds near-term records. Records are not necessarily pushed in order of their target time.
+//              An audio callback can then drain the records that fall into its block and get sample accurate offsets,
+//              which makes the lookAheadWindow act as a latency compensation. blockTime is the scheduler clock time of
+//              the block's first frame. If handler is null, record callbacks are called directly.
+//              Returns the number of drained records. Passing a null context uses the calling thread's context.
+u32 sched_action_ring_drain(sched_context* context, f64 blockTime, f64 sampleRate, u32 frameCount, sched_action_ring_handler handler, void* userPointer);
+
+//NOTE(martin): commands posted from other threads (eg. MIDI or UI threads). These are thread-safe and are executed on the
+//              scheduler fiber the next time it dispatches its messages. Posts made between sched_post_batch_begin() and
+//              sched_post_batch_end() are committed together, with a single lock and wakeup.
+//
+//              timestamp is the time at which the triggering event occurred, in seconds of the scheduler's clock
+//              (ie. ClockGetTime(SYS_CLOCK_MONOTONIC) in realtime mode). The command then takes effect at
+//              timestamp + lookAheadWindow, which gives a constant latency regardless of the dispatch jitter.
+//              Pass 0 to have the command take effect as soon as possible.
+//
+//              Posted action payloads are copied, and are limited to 64 bytes.
+void sched_post_batch_begin();
+void sched_post_batch_end();
+
+void sched_post_action(sched_action_callback callback, u32 size, char* data, f64 timestamp);
+void sched_post_fiber_wakeup(sched_fiber fiber, f64 timestamp);
+void sched_post_fiber_create(sched_task task, sched_fiber_proc proc, void* userPointer, f64 timestamp);
+void sched_post_task_set_scaling(sched_task task, f64 scaling, f64 timestamp);
+
+//NOTE(martin): swaps the tempo curve of a task, eg. with a curve obtained by editing the current one. The curve is retained
+//              until the command executes, so the caller can release its reference right after posting.
+void sched_post_task_set_curve(sched_task task, sched_curve* curve, f64 timestamp);
+
 #endif //__SCHEDULER_H_